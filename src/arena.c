@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 8
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+Arena* arena_new(size_t block_size) {
+    Arena *arena = malloc(sizeof(Arena));
+    memset(arena, 0, sizeof(Arena));
+    arena->block_size = block_size;
+    return arena;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock *block = arena->head;
+    if (!block || block->used + size > block->size) {
+        /* the rest of the current block is given up, objects larger than a block get their own */
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+        arena->bytes_reserved += block_size;
+    }
+    void *p = block->data + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    return p;
+}
+
+void arena_free(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+Pool* pool_new(size_t obj_size, int objs_per_block) {
+    Pool *pool = malloc(sizeof(Pool));
+    memset(pool, 0, sizeof(Pool));
+    /* a free object holds the free list link */
+    pool->obj_size = obj_size < sizeof(void*) ? sizeof(void*) : obj_size;
+    pool->objs_per_block = objs_per_block;
+    pool->arena = arena_new(pool->obj_size * objs_per_block);
+    return pool;
+}
+
+void* pool_alloc(Pool *pool) {
+    void *obj = pool->free_list;
+    if (obj) {
+        pool->free_list = *(void**)obj;
+    } else {
+        obj = arena_alloc(pool->arena, pool->obj_size);
+    }
+    pool->num_in_use += 1;
+    if (pool->num_in_use > pool->max_in_use) {
+        pool->max_in_use = pool->num_in_use;
+    }
+    return obj;
+}
+
+void pool_free(Pool *pool, void *obj) {
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->num_in_use -= 1;
+}
+
+void pool_destroy(Pool *pool) {
+    if (!pool) {
+        return;
+    }
+    arena_free(pool->arena);
+    free(pool);
+}
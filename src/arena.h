@@ -0,0 +1,47 @@
+/*
+ * File:   arena.h
+ *
+ * Memory for data that is allocated often and freed rarely or never.
+ * An Arena hands out memory from large blocks and frees it all at once, for
+ * the parsed trace. A Pool recycles fixed-size objects through a free list,
+ * for the entries of the server queues.
+ *
+ * Created on July 8, 2014, 10:30 AM
+ */
+
+#ifndef ARENA_H
+#define	ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena Arena;
+struct Arena {
+    ArenaBlock *head;     /* block currently allocated from */
+    size_t block_size;
+    uint64_t bytes_used;
+    uint64_t bytes_reserved;
+};
+
+Arena* arena_new(size_t block_size);
+void* arena_alloc(Arena *arena, size_t size);
+void arena_free(Arena *arena);
+
+typedef struct Pool Pool;
+struct Pool {
+    size_t obj_size;
+    int objs_per_block;
+    void *free_list;      /* recycled objects, linked through their first word */
+    Arena *arena;         /* backing memory */
+    uint64_t num_in_use;
+    uint64_t max_in_use;
+};
+
+Pool* pool_new(size_t obj_size, int objs_per_block);
+void* pool_alloc(Pool *pool);
+void pool_free(Pool *pool, void *obj);
+void pool_destroy(Pool *pool);
+
+#endif	/* ARENA_H */
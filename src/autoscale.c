@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autoscale.h"
+#include "util.h"
+#include "awe_types.h"
+#include "histogram.h"
+#include "codes/codes.h"
+
+char autoscale_spec[256] = {0};
+int scale_interval = 60;
+int scale_queue_per_client = 1;
+int scale_up_wait = 0;
+int provision_delay = 0;
+int scale_cooldown = 0;
+
+typedef struct ClientPool ClientPool;
+struct ClientPool {
+    tw_lpid *clients;   /* pre-allocated client LPs of the site */
+    int *active;        /* requested and not released, in the order of clients */
+    int size;
+    int num_active;
+    int peak_active;
+    int min;            /* -1: the whole pool, also when autoscaling is off */
+    int max;
+    double client_sec;  /* billed so far */
+    double last_change; /* in sim sec */
+};
+
+static ClientPool pools[MAX_NUM_SITES];
+static int closed = 0;
+
+void autoscale_init() {
+    memset(pools, 0, sizeof(pools));
+    closed = 0;
+    for (int s = 0; s < MAX_NUM_SITES; s++) {
+        pools[s].min = -1;
+        pools[s].max = -1;
+    }
+    if (!autoscale_spec[0]) {
+        return;
+    }
+    int site_set[MAX_NUM_SITES] = {0};
+    gchar **entries = g_strsplit(autoscale_spec, ",", MAX_NUM_SITES + 1);
+    /* entries for all sites first, so that site entries override them wherever they are listed */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; entries[i]; i++) {
+            gchar **f = g_strsplit(entries[i], ":", 4);
+            int n = g_strv_length(f);
+            int has_site = n == 3;
+            if (n < 2 || n > 3) {
+                fprintf(stderr, "bad autoscale entry \"%s\", see autoscale.h\n", entries[i]);
+                exit(1);
+            }
+            if (has_site == pass) {
+                for (int s = 0; s < MAX_NUM_SITES; s++) {
+                    if (has_site ? s == atoi(f[0]) : !site_set[s]) {
+                        pools[s].min = atoi(f[has_site]);
+                        pools[s].max = atoi(f[has_site + 1]);
+                        site_set[s] = has_site;
+                    }
+                }
+            }
+            g_strfreev(f);
+        }
+    }
+    g_strfreev(entries);
+    if (scale_queue_per_client < 1) {
+        scale_queue_per_client = 1;
+    }
+}
+
+int autoscale_enabled() {
+    return autoscale_spec[0] != 0;
+}
+
+/* add the clients active since the last change to the bill */
+static void bill(ClientPool *p, double now) {
+    if (!closed) {
+        p->client_sec += p->num_active * (now - p->last_change);
+        p->last_change = now;
+    }
+}
+
+static void set_active(ClientPool *p, int i, int active, double now) {
+    bill(p, now);
+    p->active[i] = active;
+    p->num_active += active ? 1 : -1;
+    if (p->num_active > p->peak_active) {
+        p->peak_active = p->num_active;
+    }
+}
+
+/* pool a client of the site, return 1 if it starts active */
+int autoscale_register_client(int site, tw_lpid client_id, double now) {
+    if (site < 0) {
+        return 1;
+    }
+    ClientPool *p = &pools[site];
+    p->clients = realloc(p->clients, sizeof(tw_lpid) * (p->size + 1));
+    p->active = realloc(p->active, sizeof(int) * (p->size + 1));
+    p->clients[p->size] = client_id;
+    p->active[p->size] = 0;
+    if (p->size == 0) {
+        p->last_change = now;
+    }
+    int active = p->min < 0 || p->num_active < p->min;
+    if (active) {
+        set_active(p, p->size, 1, now);
+    }
+    p->size++;
+    return active;
+}
+
+int autoscale_num_active(int site) {
+    return pools[site].num_active;
+}
+
+int autoscale_min(int site) {
+    return pools[site].min < 0 ? pools[site].size : pools[site].min;
+}
+
+int autoscale_max(int site) {
+    return pools[site].max < 0 || pools[site].max > pools[site].size ? pools[site].size : pools[site].max;
+}
+
+/* request one more client for the site, active after the provisioning delay.
+ * return 0 if the site is at its max */
+int autoscale_activate(int site, tw_lp *lp) {
+    ClientPool *p = &pools[site];
+    if (p->num_active >= autoscale_max(site)) {
+        return 0;
+    }
+    for (int i = 0; i < p->size; i++) {
+        if (!p->active[i]) {
+            set_active(p, i, 1, now_sec(lp));
+            tw_event *e = codes_event_new(p->clients[i], s_to_ns(provision_delay) + ns_tw_lookahead, lp);
+            awe_msg *msg = tw_event_data(e);
+            msg->event_type = CLIENT_ACTIVATE;
+            msg->src = lp->gid;
+            tw_event_send(e);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* release an idle client of the site */
+void autoscale_deactivate(int site, tw_lpid client_id, tw_lp *lp) {
+    ClientPool *p = &pools[site];
+    for (int i = 0; i < p->size; i++) {
+        if (p->clients[i] == client_id && p->active[i]) {
+            set_active(p, i, 0, now_sec(lp));
+            tw_event *e = codes_event_new(client_id, ns_tw_lookahead, lp);
+            awe_msg *msg = tw_event_data(e);
+            msg->event_type = CLIENT_DEACTIVATE;
+            msg->src = lp->gid;
+            tw_event_send(e);
+            return;
+        }
+    }
+}
+
+/* the workload is done, stop billing */
+void autoscale_close(double now) {
+    for (int s = 0; s < get_num_sites(); s++) {
+        bill(&pools[s], now);
+    }
+    closed = 1;
+}
+
+void autoscale_report() {
+    double total = 0;
+    for (int s = 0; s < get_num_sites(); s++) {
+        ClientPool *p = &pools[s];
+        total += p->client_sec;
+        printf("[autoscale]site=%s,pool=%d,min=%d,max=%d,peak_clients=%d,client_hours=%lf\n",
+            get_site_name(s),
+            p->size,
+            autoscale_min(s),
+            autoscale_max(s),
+            p->peak_active,
+            p->client_sec / 3600.0);
+    }
+    Histogram *turnaround = latency_get(LAT_JOB_TURNAROUND);
+    printf("[autoscale]enabled=%d,client_hours=%lf,turnaround_mean=%lf,turnaround_p95=%lf\n",
+        autoscale_enabled(),
+        total / 3600.0,
+        turnaround->count > 0 ? turnaround->sum / turnaround->count : 0.0,
+        hist_percentile(turnaround, 0.95));
+}
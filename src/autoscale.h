@@ -0,0 +1,48 @@
+/*
+ * File:   autoscale.h
+ *
+ * Elastic client pools. The client LPs of a site in the codes config are
+ * the pool it can grow to; --autoscale=[site:]min:max,... gives the clients
+ * each site starts with and may have active at most, an entry without site
+ * applying to all other sites (max -1: the whole pool).
+ *
+ * Every --scale-interval seconds each awe_server sizes the clients of the
+ * sites checking out from it to the busy ones plus one per
+ * --scale-queue-per-client queued workunits, and at least one more if the
+ * head of its queue waited longer than --scale-up-wait. Clients are added
+ * to the sites in site order, up to their max (local first, then the
+ * burst sites), and are active --provision-delay seconds later. Idle
+ * clients are released from the last site first, down to its min. After a
+ * scaling step the server waits --scale-cooldown seconds before the next.
+ *
+ * A client is billed from the time it is requested until it is released.
+ * The client-hours are reported with or without autoscaling, so elastic
+ * and static pools can be compared against their job turnaround.
+ *
+ * Created on July 21, 2014, 2:30 PM
+ */
+
+#ifndef AUTOSCALE_H
+#define	AUTOSCALE_H
+
+#include "ross.h"
+
+extern char autoscale_spec[256];
+extern int scale_interval;          //sec between scaling decisions
+extern int scale_queue_per_client;  //queued workunits one more client is added for
+extern int scale_up_wait;           //sec the queue head may wait before a client is added, 0: off
+extern int provision_delay;         //sec from requesting a client to its first checkout
+extern int scale_cooldown;          //sec after a scaling step before the next one
+
+void autoscale_init();
+int autoscale_enabled();
+int autoscale_register_client(int site, tw_lpid client_id, double now);
+int autoscale_num_active(int site);
+int autoscale_min(int site);
+int autoscale_max(int site);
+int autoscale_activate(int site, tw_lp *lp);
+void autoscale_deactivate(int site, tw_lpid client_id, tw_lp *lp);
+void autoscale_close(double now);
+void autoscale_report();
+
+#endif	/* AUTOSCALE_H */
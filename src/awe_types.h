@@ -47,8 +47,27 @@ enum awe_event_type
     UPLOAD_ACK, /* shock->endpoint, endpoint->client*/
     DNLOAD_REQ, /* client->endpoint, endpoint->shock*/
     DNLOAD_ACK, /* shock->endpoint, endpoint->client*/
+    CHUNK_SENT, /* local, a chunk of a chunked transfer left the sender*/
+    STEAL_REQ, /* awe_server->awe_server, ask a peer for queued workunits*/
+    STEAL_ACK, /* awe_server->awe_server, one stolen workunit, or none if object_id is ""*/
+    STEAL_RETRY, /* awe_server->self, retry stealing for idle clients*/
+    SAMPLE_TICK, /* awe_server->self, write a time series sample*/
+    WORK_REQUEUE, /* awe_server->self, put a workunit back in the queue, keeps its enqueue time*/
+    CHECKPOINT, /* awe_server->self, write a checkpoint*/
+    SPEC_CHECK, /* awe_server->self, dispatch a duplicate if the workunit is still running*/
+    WORK_CANCEL, /* awe_server->client, drop a copy whose duplicate finished first*/
+    CLIENT_FAIL, /* client->self, the client goes down*/
+    CLIENT_RECOVER, /* client->self, the client is repaired*/
+    LEASE_CHECK, /* awe_server->self, requeue a copy whose client failed*/
+    AUTOSCALE_TICK, /* awe_server->self, resize the client pools of its sites*/
+    CLIENT_ACTIVATE, /* awe_server->client, a pooled client is provisioned*/
+    CLIENT_DEACTIVATE, /* awe_server->client, an idle client is released*/
 };
 
+/* kind of data object carried by a DNLOAD_REQ/DNLOAD_ACK */
+#define DATA_INPUT 0
+#define DATA_PREDATA 1
+
 typedef struct awe_msg awe_msg;
 struct awe_msg {
     enum awe_event_type event_type;
@@ -56,7 +75,17 @@ struct awe_msg {
     tw_lpid next_hop;          /* for fwd msg, next hop to forward */
     tw_lpid last_hop;          /* for fwd msg, last hop before forward */
     char object_id[MAX_LENGTH_ID]; 
+    int obj_idx;    /* dense index of the job or workunit in object_id, see work_table.h */
+    int attempt;    /* copy of the workunit, numbered per checkout, see WorkRun */
     uint64_t size;  /*data size*/
+    int data_type;  /* DATA_INPUT or DATA_PREDATA */
+    int count;      /* for STEAL_REQ, number of workunits requested; for CLIENT_FAIL/RECOVER, 1 if from the MTBF process */
+    /* chunked transfers, see transfer.h */
+    uint64_t xfer_id;  /* 0 if the object is sent as a whole */
+    int chunk_idx;
+    int num_chunks;
+    tw_lpid chunk_dest;  /* receiver of the transfer, for CHUNK_SENT */
+    enum awe_event_type chunk_event_type;  /* event type of the chunks, for CHUNK_SENT */
     int incremented_flag; /* helper for reverse computation */
 };
 
@@ -80,14 +109,9 @@ struct TaskStat {
     long size_outfile;
 };
 
+/* per-workunit numbers from the trace, see WorkParams in work_table.h */
 typedef struct WorkStat WorkStat;
 struct WorkStat {
-    double st_created;
-    double st_checkout;
-    double st_download_start;
-    double st_download_end;
-    double st_upload_start;
-    double st_upload_end;
     double time_predata_in;
     double runtime;
     double time_data_in;
@@ -102,26 +126,25 @@ struct DataObj {
     char name[MAX_NAME_LENGTH_WKLD];
     char host[MAX_NAME_LENGTH_WKLD];
     char nodeid[MAX_LENGTH_ID];
-    int size;
+    uint64_t size;
 };
 
+/* trace metadata of a workunit, read-only after parsing. its numbers and
+ * run state are kept by index in work_params and work_runs (work_table.h) */
 typedef struct Workunit Workunit;
 struct Workunit {
     char id[MAX_LENGTH_ID];
     char jobid[MAX_LENGTH_ID];
+    int idx;
+    int job_idx;
     int stage;
     int rank;
-    int num_inputs;
-    DataObj Inputs[MAX_IO_FILE_NUM];
-    int num_outputs;
-    DataObj Outputs[MAX_IO_FILE_NUM];
     int num_predata;
-    DataObj Predata[MAX_IO_FILE_NUM];
+    DataObj *Predata;  /* num_predata objects, in the trace arena */
     char cmd[MAX_NAME_LENGTH_WKLD];
-    char state[MAX_NAME_LENGTH_WKLD];
     int splits;
     int max_split_size;
-    struct WorkStat stats;
+    int mem_mb;    /* memory the workunit needs, 0: unknown, see capability.h */
 };
 
 typedef struct Task Task;
@@ -137,8 +160,10 @@ struct Task{
 
 typedef struct Job {
     char id[MAX_LENGTH_ID];
+    int idx;
     char username[MAX_NAME_LENGTH_WKLD];
     char project[MAX_NAME_LENGTH_WKLD];
+    int priority;    /* class for fair-share, higher first, see fairshare.h */
     char pipeline[MAX_NAME_LENGTH_WKLD];
     uint64_t inputsize;
     int num_tasks;
@@ -146,7 +171,9 @@ typedef struct Job {
     int task_splits[MAX_NUM_TASKS];
     int task_remainwork[MAX_NUM_TASKS];
     int task_dep[MAX_NUM_TASKS][MAX_NUM_TASKS];
+    int task_parents[MAX_NUM_TASKS]; /* bitmask of upstream tasks, immutable unlike task_dep */
     int task_states[MAX_NUM_TASKS];  /* 0=pending, 1=parsed, 2=completed*/
+    TaskStat task_stats[MAX_NUM_TASKS]; /* in sim sec, start < 0 until the first workunit is checked out */
     char state[MAX_LENGTH_STATE];
     JobStat stats;
 }Job;
@@ -12,6 +12,18 @@
 #include "lp_awe_client.h"
 #include "lp_shock.h"
 #include "lp_shock_router.h"
+#include "transfer.h"
+#include "sampler.h"
+#include "histogram.h"
+#include "profile.h"
+#include "sweep.h"
+#include "checkpoint.h"
+#include "straggler.h"
+#include "failure.h"
+#include "autoscale.h"
+#include "fairshare.h"
+#include "predict.h"
+#include "capability.h"
 
 #include "ross.h"
 #include "codes/codes.h"
@@ -28,6 +40,14 @@ char jobtrace_file_name[256]={0};
 char output_file_name[256]={0};
 int sched_policy = 0;
 int fraction_arg = 0;
+int router_cache_size = 0;
+int router_cache_policy = 0;
+int client_predata_cache = 0;
+int steal_batch = 0;
+int steal_min_idle = 1;
+int steal_min_queue = 0;
+int steal_latency = 50;
+int steal_retry = 60;
 /* this struct contains default parameters used by ROSS, as well as
  * user-specific arguments to be handled by the ROSS config sys. Pass it in
  * prior to calling tw_init */
@@ -38,11 +58,96 @@ const tw_optdef app_opt [] =
     TWOPT_CHAR("worktrace", worktrace_file_name, "workload trace of workunit"),
     TWOPT_CHAR("jobtrace", jobtrace_file_name, "job trace"),
     TWOPT_CHAR("output", output_file_name, "output file name"),
-    TWOPT_UINT("sched-policy", sched_policy, "scheduling policy"),
+    TWOPT_UINT("sched-policy", sched_policy, "scheduling policy (0: round-robin, 1: data-aware-best-fit, 2: data-aware-greedy, 3: predata-aware, 4: fair-share, 5: critical-path, 6: shortest-job-first, 7: predicted data-aware)"),
     TWOPT_UINT("fraction", fraction_arg, "fraction of job arrival intervals (1-99, meaning 1%-99%)"),
+    TWOPT_GROUP("Trace window and job sampling" ),
+    TWOPT_UINT("window-start", window_start, "skip jobs queued before this epoch time (0: from the first job)"),
+    TWOPT_UINT("window-end", window_end, "skip jobs queued at or after this epoch time (0: up to the last job)"),
+    TWOPT_UINT("job-sample", job_sample_rate, "simulate this percent of jobs, chosen by hash of job id, and of each site's clients (0: all)"),
+    TWOPT_GROUP("Parameter sweep" ),
+    TWOPT_CHAR("sweep", sweep_file_name, "run the configurations listed in this file in forked workers, see sweep.h"),
+    TWOPT_UINT("sweep-workers", sweep_workers, "number of concurrent sweep runs (0: one per cpu)"),
+    TWOPT_CHAR("sweep-dir", sweep_dir, "directory for per-run output and sweep_results.csv (default sweep)"),
+    TWOPT_GROUP("Checkpoint and restart" ),
+    TWOPT_UINT("checkpoint-at", checkpoint_at, "sim time in sec at which to write a checkpoint (0: none)"),
+    TWOPT_CHAR("checkpoint-file", checkpoint_file_name, "checkpoint output file (default awesim.ckpt)"),
+    TWOPT_UINT("checkpoint-stop", checkpoint_stop, "end the run once the checkpoint is written (0: no, 1: yes)"),
+    TWOPT_CHAR("restart", restart_file_name, "resume from this checkpoint, same traces and codes config as the checkpointed run"),
+    TWOPT_UINT("warm-start", warm_start, "start this many sec into the trace with queue state estimated from the trace (ignored with --restart)"),
+    TWOPT_GROUP("Self-profiling" ),
+    TWOPT_UINT("profile", profile_enabled, "count events and handler cycles per lp type and event type, time startup phases (0: off, 1: on)"),
+    TWOPT_GROUP("Time series sampling" ),
+    TWOPT_UINT("sample-interval", sample_interval, "simulated seconds between samples of queues, clients and links (0: disabled)"),
+    TWOPT_CHAR("sample-file", sample_file_name, "time series output file (default awesim_samples.csv)"),
+    TWOPT_GROUP("Work stealing between per-site awe_servers" ),
+    TWOPT_UINT("steal-batch", steal_batch, "max workunits taken from a peer server per steal (0: stealing disabled)"),
+    TWOPT_UINT("steal-min-idle", steal_min_idle, "idle clients needed before a server with an empty queue steals"),
+    TWOPT_UINT("steal-min-queue", steal_min_queue, "workunits a victim server always keeps queued"),
+    TWOPT_UINT("steal-latency", steal_latency, "fixed one-way server-to-server latency of steal messages in ms, not modelled on the network"),
+    TWOPT_UINT("steal-retry", steal_retry, "seconds between steal attempts while clients stay idle (0: only on checkout)"),
+    TWOPT_GROUP("Shock router object cache" ),
+    TWOPT_UINT("router-cache-size", router_cache_size, "capacity of the object cache on shock_router in MB (0: disabled)"),
+    TWOPT_UINT("router-cache-policy", router_cache_policy, "cache eviction policy (0: LRU, 1: size-aware, largest first)"),
+    TWOPT_GROUP("Data transfer" ),
+    TWOPT_UINT("chunk-size", chunk_size, "split objects larger than this into chunks, in MB (0: send objects as a whole)"),
+    TWOPT_UINT("num-streams", num_streams, "number of parallel streams per chunked transfer"),
+    TWOPT_GROUP("Client predata cache" ),
+    TWOPT_UINT("client-predata-cache", client_predata_cache, "capacity of the predata cache on each client in MB (0: download predata for every workunit)"),
+    TWOPT_GROUP("Stragglers and speculative execution" ),
+    TWOPT_CHAR("slowdown", slowdown_spec, "runtime slowdown per execution, [site:]dist,... with dist none, lognormal:sigma, pareto:alpha or bimodal:pct:factor, see straggler.h"),
+    TWOPT_UINT("spec-percentile", spec_percentile, "duplicate a workunit running longer than this percentile of its stage (0: no speculative execution)"),
+    TWOPT_UINT("spec-min-samples", spec_min_samples, "finished workunits of a stage before its workunits are duplicated"),
+    TWOPT_GROUP("Client failures" ),
+    TWOPT_CHAR("failures", failure_spec, "client failures, [site:]mtbf:mttr,... in sec, see failure.h"),
+    TWOPT_CHAR("outage-file", outage_file_name, "client outages, one \"site client start end\" per line, see failure.h"),
+    TWOPT_UINT("lease-timeout", lease_timeout, "sec until a workunit on a failed client is requeued (0: never, 600 with failures)"),
+    TWOPT_UINT("work-ckpt-interval", work_ckpt_interval, "compute sec between workunit checkpoints (0: no checkpoints)"),
+    TWOPT_UINT("work-ckpt-cost", work_ckpt_cost, "sec to write one workunit checkpoint"),
+    TWOPT_GROUP("Fair-share scheduling (sched-policy 4)" ),
+    TWOPT_UINT("fs-halflife", fs_halflife, "half-life of the user and project usage in sec (default 86400, 0: no decay)"),
+    TWOPT_UINT("fs-project-weight", fs_project_weight, "weight of the project usage against the user usage (default 1)"),
+    TWOPT_GROUP("Client autoscaling" ),
+    TWOPT_CHAR("autoscale", autoscale_spec, "clients per site, [site:]min:max,... (max -1: all configured clients), see autoscale.h"),
+    TWOPT_UINT("scale-interval", scale_interval, "sec between scaling decisions (default 60)"),
+    TWOPT_UINT("scale-queue-per-client", scale_queue_per_client, "queued workunits one more client is added for (default 1)"),
+    TWOPT_UINT("scale-up-wait", scale_up_wait, "add a client once the queue head waited this many sec (0: off)"),
+    TWOPT_UINT("provision-delay", provision_delay, "sec from requesting a client to its first checkout"),
+    TWOPT_UINT("scale-cooldown", scale_cooldown, "sec after a scaling step before the next one"),
+    TWOPT_GROUP("Runtime prediction (sched-policy 5-7)" ),
+    TWOPT_UINT("predict-oracle", predict_oracle, "policies see the trace runtime and output size instead of the learned predictions (0: no, 1: yes)"),
+    TWOPT_UINT("predict-window", predict_window, "queued workunits a remote client chooses from under sched-policy 7 (default 64)"),
+    TWOPT_GROUP("Heterogeneous clients" ),
+    TWOPT_CHAR("client-file", client_file_name, "client classes, one \"site clients speed mem_mb disk_mb apps\" per line, see capability.h"),
     {TWOPT_END()}
 };
 
+/* options of a run forked by a sweep override the command line */
+static void apply_sweep_config(SweepConfig *sc) {
+    snprintf(conf_file_name, sizeof(conf_file_name), "%s", sc->codes_config);
+    snprintf(output_file_name, sizeof(output_file_name), "%s", sc->output_file);
+    if (sc->sched_policy >= 0) {
+        sched_policy = sc->sched_policy;
+    }
+    if (sc->fraction >= 0) {
+        fraction_arg = sc->fraction;
+    }
+    if (sc->slowdown[0]) {
+        snprintf(slowdown_spec, sizeof(slowdown_spec), "%s", sc->slowdown);
+    }
+    if (sc->spec_percentile >= 0) {
+        spec_percentile = sc->spec_percentile;
+    }
+    if (sc->failures[0]) {
+        snprintf(failure_spec, sizeof(failure_spec), "%s", sc->failures);
+    }
+    if (sc->autoscale[0]) {
+        snprintf(autoscale_spec, sizeof(autoscale_spec), "%s", sc->autoscale);
+    }
+    if (sample_interval > 0) {
+        snprintf(sample_file_name, sizeof(sample_file_name), "%s/%s_samples.csv", sweep_dir, sc->name);
+    }
+}
+
 int main(
     int argc,
     char **argv)
@@ -50,8 +155,16 @@ int main(
     int nprocs;
     int rank;
     int num_nets, *net_ids;
+    double t_start = prof_wall_time();
+
+    /* a sweep parent returns here once all runs are done, forked runs go on */
+    int rc = sweep_main(argc, argv);
+    if (rc >= 0) {
+        return rc;
+    }
     
-    /* TODO: explain why we need this (ROSS has cutoff??) */
+    /* upper bound of simulated time, the awe_server ends the run earlier
+     * once every job is done (see end_simulation) */
     g_tw_ts_end = s_to_ns(60*60*24*365); /* one year, in nsecs */
 
     /* ROSS initialization function calls */
@@ -59,6 +172,16 @@ int main(
     /* initialize ROSS and parse args. NOTE: tw_init calls MPI_Init */
     tw_init(&argc, &argv); 
 
+    if (sweep_get_config()) {
+        apply_sweep_config(sweep_get_config());
+    }
+
+    straggler_init();
+    failure_init();
+    autoscale_init();
+    predict_init();
+    cap_init();
+
     if (!conf_file_name[0]) 
     {
         fprintf(stderr, "Expected \"codes-config\" option, please see --help.\n");
@@ -90,11 +213,14 @@ int main(
     /* loading the config file into the codes-mapping utility, giving us the
      * parsed config object in return. 
      * "config" is a global var defined by codes-mapping */
+    double t_phase = prof_wall_time();
     if (configuration_load(conf_file_name, MPI_COMM_WORLD, &config)){
         fprintf(stderr, "Error loading config file %s.\n", conf_file_name);
         MPI_Finalize();
         return 1;
     }
+    prof_phase_add(PROF_PHASE_CONFIG_LOAD, prof_wall_time() - t_phase);
+    sweep_config_loaded();
     
     model_net_register();
 
@@ -137,16 +263,33 @@ int main(
      * generates/places the LPs as specified in the configuration file. 
      * This should only be called after ALL LP types have been registered in 
      * codes */
+    t_phase = prof_wall_time();
     codes_mapping_setup();
+    prof_phase_add(PROF_PHASE_MAPPING_SETUP, prof_wall_time() - t_phase);
     
     init_awe_server();
     
     printf("+++++%u, \n", g_tw_events_per_pe);    
     /* begin simulation */ 
+    t_phase = prof_wall_time();
+    prof_phase_add(PROF_PHASE_STARTUP, t_phase - t_start);
     tw_run();
+    prof_phase_add(PROF_PHASE_RUN, prof_wall_time() - t_phase);
     
     /* model-net has the capability of outputting network transmission stats */
     model_net_report_stats(net_id);
+    transfer_report_stats();
+    latency_report();
+    straggler_report();
+    failure_report();
+    autoscale_report();
+    fs_report();
+    predict_report();
+    cap_report();
+    report_workload_summary();
+    profile_report();
+    profile_summary();
+    sampler_close();
 
     tw_end();
 
@@ -0,0 +1,85 @@
+#!/bin/bash
+#
+# Benchmark awesim end to end on generated traces.
+#
+# Runs every combination of trace size, number of clients and sched_policy on
+# the one-site WAN config, and writes one CSV row per run with wall time,
+# startup time, committed events, events/sec and peak RSS (taken from the
+# [awesim-summary] line). If a baseline CSV from an earlier run is given, rows
+# are compared by (jobs, clients, policy) and the script exits non-zero when
+# events/sec drops or peak RSS grows by more than THRESHOLD percent.
+#
+# usage: ./bench.sh [-o results.csv] [-b baseline.csv] [-t threshold_pct]
+# scale points can be overridden with BENCH_JOBS, BENCH_CLIENTS, BENCH_POLICIES
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+CONF_DIR="$HERE/../conf"
+RESULTS=bench_results.csv
+BASELINE=
+THRESHOLD=10
+
+while getopts "o:b:t:" opt; do
+    case $opt in
+        o) RESULTS=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        t) THRESHOLD=$OPTARG ;;
+        *) echo "usage: $0 [-o results.csv] [-b baseline.csv] [-t threshold_pct]"; exit 1 ;;
+    esac
+done
+
+JOBS=${BENCH_JOBS:-"100 1000 10000"}
+CLIENTS=${BENCH_CLIENTS:-"10 100"}
+POLICIES=${BENCH_POLICIES:-"0 1 2 3 4 5 6 7"}  # every --sched-policy, see awesim.c
+SEED=1
+
+for bin in awesim tracegen; do
+    if [ ! -x "$HERE/$bin" ]; then
+        echo "$HERE/$bin not built, run make $bin first"
+        exit 1
+    fi
+done
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+cp "$CONF_DIR"/modelnet-simplewan-*-onesite.conf "$WORK_DIR"
+
+echo "jobs,workunits,clients,policy,wall_time,startup_time,run_time,committed_events,events_per_sec,peak_rss_kb" > "$RESULTS"
+
+for jobs in $JOBS; do
+    "$HERE/tracegen" --jobs $jobs --splits uniform:1:8 --users 20 --seed $SEED \
+        --jobtrace "$WORK_DIR/bench.jobs" --worktrace "$WORK_DIR/bench.works" > /dev/null
+    works=$(wc -l < "$WORK_DIR/bench.works")
+    for clients in $CLIENTS; do
+        sed "s/#clients/$clients/" "$CONF_DIR/awesim_wan_one_site.conf" > "$WORK_DIR/bench.conf"
+        for policy in $POLICIES; do
+            summary=$(cd "$WORK_DIR" && "$HERE/awesim" --synch=1 --codes-config=bench.conf \
+                --jobtrace=bench.jobs --worktrace=bench.works --output=bench.log \
+                --sched-policy=$policy | grep '^\[awesim-summary\]')
+            # key=value,... -> values in header order
+            row=$(echo "${summary#\[awesim-summary\]}" | tr ',' '\n' | cut -d= -f2 | paste -sd, -)
+            echo "$jobs,$works,$clients,$policy,$row" >> "$RESULTS"
+            echo "[bench]jobs=$jobs, workunits=$works, clients=$clients, policy=$policy: $summary"
+        done
+    done
+done
+
+echo "[bench]results written to $RESULTS"
+
+if [ -n "$BASELINE" ]; then
+    awk -F, -v threshold=$THRESHOLD '
+        FNR == 1 { next }
+        NR == FNR { eps[$1","$3","$4] = $9; rss[$1","$3","$4] = $10; next }
+        {
+            key = $1","$3","$4
+            if (!(key in eps)) next
+            eps_change = eps[key] > 0 ? ($9 - eps[key]) / eps[key] * 100 : 0
+            rss_change = rss[key] > 0 ? ($10 - rss[key]) / rss[key] * 100 : 0
+            flag = ""
+            if (eps_change < -threshold || rss_change > threshold) { flag = " REGRESSION"; bad++ }
+            printf "[bench]jobs=%s, clients=%s, policy=%s: events_per_sec %+.1f%%, peak_rss %+.1f%%%s\n", $1, $3, $4, eps_change, rss_change, flag
+        }
+        END { exit bad > 0 }
+    ' "$BASELINE" "$RESULTS" || { echo "[bench]regressions beyond ${THRESHOLD}% against $BASELINE"; exit 1; }
+fi
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capability.h"
+#include "work_table.h"
+#include "util.h"
+
+char client_file_name[256] = {0};
+
+typedef struct ClientClass ClientClass;
+struct ClientClass {
+    double speed;
+    uint64_t mem_mb;     /* 0: unlimited */
+    uint64_t disk_mb;    /* 0: unlimited */
+    char apps_spec[256];
+    gchar **apps;        /* NULL: all cmds */
+    int num_clients;
+    uint64_t num_runs;   /* executions run to completion */
+    double compute_time; /* in sec, of those executions */
+};
+
+/* a line of the client file */
+typedef struct ClientLine ClientLine;
+struct ClientLine {
+    int site;
+    int first;   /* pool indices first..last within the site */
+    int last;    /* -1: to the end of the pool */
+    int cls;
+};
+
+static ClientClass classes[CAP_MAX_CLASSES];
+static int num_classes = 0;
+static ClientLine *lines = NULL;
+static int num_lines = 0;
+static GHashTable *client_class = NULL;   /* client lpid -> class + 1 */
+static uint64_t site_mask[MAX_NUM_SITES]; /* classes of the clients of each site */
+static GHashTable *app_masks = NULL;      /* cmd -> classes running it */
+static uint64_t *work_mask = NULL;        /* work idx -> classes it can run on, 0: not computed yet */
+static uint64_t num_unmatched = 0;        /* workunits no class can run, let run anywhere */
+
+static uint64_t all_classes() {
+    return num_classes >= 64 ? ~0ULL : (1ULL << num_classes) - 1;
+}
+
+/* index of the class with these attributes, added if new */
+static int get_class(double speed, uint64_t mem_mb, uint64_t disk_mb, const char *apps) {
+    for (int c = 0; c < num_classes; c++) {
+        ClientClass *cc = &classes[c];
+        if (cc->speed == speed && cc->mem_mb == mem_mb && cc->disk_mb == disk_mb && strcmp(cc->apps_spec, apps) == 0) {
+            return c;
+        }
+    }
+    if (num_classes == CAP_MAX_CLASSES) {
+        fprintf(stderr, "more than %d client classes in %s\n", CAP_MAX_CLASSES, client_file_name);
+        exit(1);
+    }
+    ClientClass *cc = &classes[num_classes];
+    memset(cc, 0, sizeof(ClientClass));
+    cc->speed = speed;
+    cc->mem_mb = mem_mb;
+    cc->disk_mb = disk_mb;
+    snprintf(cc->apps_spec, sizeof(cc->apps_spec), "%s", apps);
+    cc->apps = strcmp(apps, "*") == 0 ? NULL : g_strsplit(apps, ",", -1);
+    return num_classes++;
+}
+
+static void load_client_file() {
+    FILE *f = fopen(client_file_name, "r");
+    if (f == NULL) {
+        perror(client_file_name);
+        exit(1);
+    }
+    char line[MAX_LEN_TRACE_LINE];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        g_strstrip(line);
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+        ClientLine cl;
+        char clients[64], apps[256];
+        double speed;
+        unsigned long long mem_mb, disk_mb;
+        if (sscanf(line, "%d %63s %lf %llu %llu %255s", &cl.site, clients, &speed, &mem_mb, &disk_mb, apps) != 6
+                || cl.site < 0 || cl.site >= MAX_NUM_SITES || speed <= 0) {
+            fprintf(stderr, "bad client class \"%s\" in %s, see capability.h\n", line, client_file_name);
+            exit(1);
+        }
+        if (strcmp(clients, "*") == 0) {
+            cl.first = 0;
+            cl.last = -1;
+        } else if (sscanf(clients, "%d-%d", &cl.first, &cl.last) != 2) {
+            cl.first = cl.last = atoi(clients);
+        }
+        cl.cls = get_class(speed, mem_mb, disk_mb, apps);
+        lines = realloc(lines, sizeof(ClientLine) * (num_lines + 1));
+        lines[num_lines++] = cl;
+    }
+    fclose(f);
+    printf("[capability]%d client classes loaded from %s\n", num_classes, client_file_name);
+}
+
+void cap_init() {
+    num_unmatched = 0;
+    memset(site_mask, 0, sizeof(site_mask));
+    if (client_file_name[0]) {
+        load_client_file();
+    }
+}
+
+int cap_enabled() {
+    return client_file_name[0] != 0;
+}
+
+/* class of the idx-th client of the site, from the last line listing it */
+int cap_register_client(int site, int idx, tw_lpid client_id) {
+    int cls = -1;
+    for (int i = 0; i < num_lines; i++) {
+        ClientLine *cl = &lines[i];
+        if (cl->site == site && idx >= cl->first && (cl->last < 0 || idx <= cl->last)) {
+            cls = cl->cls;
+        }
+    }
+    if (cls < 0) {
+        cls = get_class(1.0, 0, 0, "*");
+    }
+    if (!client_class) {
+        client_class = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    g_hash_table_insert(client_class, GSIZE_TO_POINTER(client_id), GINT_TO_POINTER(cls + 1));
+    classes[cls].num_clients++;
+    if (site >= 0) {
+        site_mask[site] |= 1ULL << cls;
+    }
+    return cls;
+}
+
+int cap_client_class(tw_lpid client_id) {
+    return client_class ? GPOINTER_TO_INT(g_hash_table_lookup(client_class, GSIZE_TO_POINTER(client_id))) - 1 : -1;
+}
+
+double cap_speed(int cls) {
+    return cls >= 0 ? classes[cls].speed : 1.0;
+}
+
+/* classes whose apps include the cmd, once per cmd */
+static uint64_t app_mask(const char *cmd) {
+    if (!app_masks) {
+        app_masks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+    uint64_t *mask = g_hash_table_lookup(app_masks, cmd);
+    if (!mask) {
+        mask = g_new0(uint64_t, 1);
+        for (int c = 0; c < num_classes; c++) {
+            int runs = classes[c].apps == NULL;
+            for (int i = 0; !runs && classes[c].apps[i]; i++) {
+                runs = strcmp(classes[c].apps[i], cmd) == 0;
+            }
+            if (runs) {
+                *mask |= 1ULL << c;
+            }
+        }
+        g_hash_table_insert(app_masks, g_strdup(cmd), mask);
+    }
+    return *mask;
+}
+
+/* the classes the workunit can run on, computed on first use: the clients have
+ * all registered by then, while the traces are parsed after cap_init */
+static uint64_t get_work_mask(Workunit *work) {
+    if (!work_mask) {
+        work_mask = calloc(num_works, sizeof(uint64_t));
+    }
+    int w = work->idx;
+    if (work_mask[w]) {
+        return work_mask[w];
+    }
+    uint64_t disk_mb = (work_params.size_infile[w] + work_params.size_predata[w] + work_params.size_outfile[w]) / Mega;
+    uint64_t apps = app_mask(work->cmd);
+    uint64_t mask = 0;
+    for (int c = 0; c < num_classes; c++) {
+        ClientClass *cc = &classes[c];
+        if (((apps >> c) & 1) && (cc->mem_mb == 0 || (uint64_t)work->mem_mb <= cc->mem_mb)
+                && (cc->disk_mb == 0 || disk_mb <= cc->disk_mb)) {
+            mask |= 1ULL << c;
+        }
+    }
+    if (!mask) {
+        num_unmatched++;
+        mask = all_classes();
+    }
+    work_mask[w] = mask;
+    return mask;
+}
+
+int cap_class_match(int cls, Workunit *work) {
+    return cls < 0 || ((get_work_mask(work) >> cls) & 1);
+}
+
+/* some client of the site can run the workunit */
+int cap_site_match(int site, Workunit *work) {
+    return site >= 0 && (get_work_mask(work) & site_mask[site]) != 0;
+}
+
+/* add delta to the queued workunit count of every class that can run the workunit */
+void cap_count_queued(int *queued, Workunit *work, int delta) {
+    for (uint64_t mask = get_work_mask(work); mask; mask &= mask - 1) {
+        queued[__builtin_ctzll(mask)] += delta;
+    }
+}
+
+void cap_record_run(int cls, double compute_sec) {
+    if (cls >= 0) {
+        classes[cls].num_runs++;
+        classes[cls].compute_time += compute_sec;
+    }
+}
+
+void cap_report() {
+    if (!cap_enabled()) {
+        return;
+    }
+    for (int c = 0; c < num_classes; c++) {
+        ClientClass *cc = &classes[c];
+        char apps[256];
+        strcpy(apps, cc->apps_spec);
+        g_strdelimit(apps, ",", '+');  /* keep the line key=value,... */
+        printf("[capability]class=%d,speed=%.2lf,mem_mb=%llu,disk_mb=%llu,apps=%s,clients=%d,runs=%llu,compute_time=%lf\n",
+            c, cc->speed, (unsigned long long)cc->mem_mb, (unsigned long long)cc->disk_mb, apps,
+            cc->num_clients, (unsigned long long)cc->num_runs, cc->compute_time);
+    }
+    printf("[capability]classes=%d,unmatched_works=%llu\n", num_classes, (unsigned long long)num_unmatched);
+}
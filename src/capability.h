@@ -0,0 +1,53 @@
+/*
+ * File:   capability.h
+ *
+ * Heterogeneous clients. --client-file gives the clients of each site a
+ * class, one per line:
+ *   site clients speed mem_mb disk_mb apps
+ * with clients "*", a pool index n or a range a-b within the site, speed the
+ * factor the trace runtime is divided by, mem_mb and disk_mb the node memory
+ * and local disk (0: unlimited) and apps "*" or a comma separated list of the
+ * cmds the client runs. A later line overrides earlier ones for the clients
+ * it lists; clients no line lists run everything at speed 1. e.g.
+ *   0 * 1.0 16384 500000 *
+ *   0 0-7 2.0 65536 1000000 *
+ *   1 * 0.5 8192 100000 blat
+ *
+ * A workunit needs its cmd among the apps, its mem_mb from the work trace
+ * (0 if absent) and room for its input, predata and output on disk. The
+ * classes a workunit can run on are computed once into a bitmask, and each
+ * awe_server counts its queued workunits per class, so a checkout tests one
+ * bit per workunit and returns at once when nothing queued fits the client.
+ * Every policy then chooses as usual among the queued workunits the client
+ * can run: fair-share the first of those in the queue it would serve next,
+ * critical-path and shortest-job-first the first in heap order, the others
+ * the first in their own scan of the queue. A client waiting for work is
+ * matched by class, not by the "remote site runs stage 5" rule.
+ *
+ * Created on July 30, 2014, 2:40 PM
+ */
+
+#ifndef CAPABILITY_H
+#define	CAPABILITY_H
+
+#include <stdint.h>
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+#define CAP_MAX_CLASSES 64
+
+extern char client_file_name[256];
+
+void cap_init();
+int cap_enabled();
+int cap_register_client(int site, int idx, tw_lpid client_id);
+int cap_client_class(tw_lpid client_id);
+double cap_speed(int cls);
+int cap_class_match(int cls, Workunit *work);
+int cap_site_match(int site, Workunit *work);
+void cap_count_queued(int *queued, Workunit *work, int delta);
+void cap_record_run(int cls, double compute_sec);
+void cap_report();
+
+#endif	/* CAPABILITY_H */
@@ -0,0 +1,419 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "checkpoint.h"
+#include "util.h"
+#include "work_table.h"
+
+#define MAX_LEN_CKPT_LINE 8192
+
+int checkpoint_at = 0;
+int checkpoint_stop = 0;
+char checkpoint_file_name[256] = "awesim.ckpt";
+char restart_file_name[256] = {0};
+int warm_start = 0;
+
+/* registered at lp init, for writing */
+static GQueue* server_work_queue[MAX_NUM_SITES];
+static int num_servers = 0;
+static GHashTable *caches = NULL;  /* lp id -> ObjCache */
+
+/* read at restart, consumed at lp init */
+static GQueue* restored_queue[MAX_NUM_SITES];
+static GHashTable *restored_caches = NULL;  /* lp id -> GQueue of "size:name", least recently used first */
+
+void checkpoint_register_server(int server_idx, GQueue* work_queue) {
+    assert(server_idx < MAX_NUM_SITES);
+    server_work_queue[server_idx] = work_queue;
+    if (server_idx >= num_servers) {
+        num_servers = server_idx + 1;
+    }
+}
+
+/* remember a cache for checkpoints, and fill it from the restart file if any */
+void checkpoint_register_cache(tw_lpid lp_id, ObjCache *cache) {
+    if (!caches) {
+        caches = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    g_hash_table_insert(caches, GSIZE_TO_POINTER(lp_id), cache);
+    GQueue *entries = restored_caches ? g_hash_table_lookup(restored_caches, GSIZE_TO_POINTER(lp_id)) : NULL;
+    if (!entries) {
+        return;
+    }
+    char *entry;
+    while ((entry = g_queue_pop_head(entries))) {
+        char *name = strchr(entry, ':');
+        obj_cache_insert(cache, name + 1, strtoull(entry, NULL, 10));
+        g_free(entry);
+    }
+    g_hash_table_remove(restored_caches, GSIZE_TO_POINTER(lp_id));
+    g_queue_free(entries);
+}
+
+/* workunits queued on a server at checkpoint time, in queue order; NULL if none.
+ * the caller owns the queue and the ids in it */
+GQueue* checkpoint_take_queue(int server_idx) {
+    GQueue *queue = restored_queue[server_idx];
+    restored_queue[server_idx] = NULL;
+    return queue;
+}
+
+static void write_int_array(FILE *f, const char *key, int *values, int n) {
+    fprintf(f, ";%s=", key);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, i ? ",%d" : "%d", values[i]);
+    }
+}
+
+static void write_task_times(FILE *f, const char *key, Job *job, size_t offset) {
+    fprintf(f, ";%s=", key);
+    for (int i = 0; i < job->num_tasks; i++) {
+        double t = *(double*)((char*)&job->task_stats[i] + offset);
+        fprintf(f, i ? ",%.3lf" : "%.3lf", t);
+    }
+}
+
+static FILE *cache_file = NULL;
+static tw_lpid cache_lp_id = 0;
+
+static void write_cache_entry(const char *obj_id, uint64_t size, void *data) {
+    fprintf(cache_file, "cache=%lu;size=%llu;obj=%s\n", cache_lp_id, (unsigned long long)size, obj_id);
+}
+
+void checkpoint_write(double now) {
+    FILE *f = fopen(checkpoint_file_name, "w");
+    if (f == NULL) {
+        perror(checkpoint_file_name);
+        return;
+    }
+    fprintf(f, "checkpoint=%s;time=%lf;kickoff_epoch_time=%lf\n", jobtrace_file_name, now, kickoff_epoch_time);
+
+    int jobs_written = 0;
+    int works_written = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, job_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Job* job = (Job*)value;
+        if (strcmp(job->state, "raw") == 0) {
+            continue;
+        }
+        fprintf(f, "job=%s;state=%s;start=%.3lf;end=%.3lf;remain_tasks=%d", job->id, job->state, job->stats.start, job->stats.end, job->remain_tasks);
+        write_int_array(f, "task_states", job->task_states, job->num_tasks);
+        write_int_array(f, "task_remainwork", job->task_remainwork, job->num_tasks);
+        write_task_times(f, "task_created", job, offsetof(TaskStat, created));
+        write_task_times(f, "task_start", job, offsetof(TaskStat, start));
+        write_task_times(f, "task_end", job, offsetof(TaskStat, end));
+        fprintf(f, "\n");
+        jobs_written += 1;
+        /* workunits of tasks that have been made ready */
+        for (int i = 0; i < job->num_tasks; i++) {
+            if (job->task_states[i] == 0) {
+                continue;
+            }
+            int first = job->task_splits[i] == 1 ? 0 : 1;
+            for (int r = first; r < first + job->task_splits[i]; r++) {
+                char work_id[MAX_LENGTH_ID];
+                sprintf(work_id, "%s_%d_%d", job->id, i, r);
+                Workunit* work = g_hash_table_lookup(work_map, work_id);
+                if (work) {
+                    WorkRun *run = &work_runs[work->idx];
+                    fprintf(f, "work=%s;done=%d;created=%.3lf;checkout=%.3lf\n", work_id, run->state == WORK_DONE, run->st_created, run->st_checkout);
+                    works_written += 1;
+                }
+            }
+        }
+    }
+
+    for (int s = 0; s < num_servers; s++) {
+        for (GList *link = g_queue_peek_head_link(server_work_queue[s]); link; link = link->next) {
+            fprintf(f, "queue=%d;work=%s\n", s, ((Workunit*)link->data)->id);
+        }
+    }
+
+    if (caches) {
+        cache_file = f;
+        g_hash_table_iter_init(&iter, caches);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            cache_lp_id = GPOINTER_TO_SIZE(key);
+            obj_cache_foreach((ObjCache*)value, write_cache_entry, NULL);
+        }
+    }
+    fclose(f);
+    printf("[checkpoint]time=%lf, file=%s, jobs=%d, workunits=%d\n", now, checkpoint_file_name, jobs_written, works_written);
+}
+
+static void parse_int_array(char *val, int *values, int max) {
+    gchar **parts = g_strsplit(val, ",", max);
+    for (int i = 0; parts[i]; i++) {
+        values[i] = atoi(parts[i]);
+    }
+    g_strfreev(parts);
+}
+
+static void parse_task_times(char *val, Job *job, size_t offset) {
+    gchar **parts = g_strsplit(val, ",", MAX_NUM_TASKS);
+    for (int i = 0; parts[i]; i++) {
+        *(double*)((char*)&job->task_stats[i] + offset) = atof(parts[i]);
+    }
+    g_strfreev(parts);
+}
+
+/* a dependency is resolved once the upstream task is complete */
+static void resolve_task_deps(Job *job) {
+    for (int i = 0; i < job->num_tasks; i++) {
+        for (int j = 0; j < job->num_tasks; j++) {
+            job->task_dep[i][j] = (job->task_parents[i] & (1 << j)) && job->task_states[j] != 2;
+        }
+    }
+}
+
+static void restore_job(Job *job, gchar **parts) {
+    for (int i = 1; parts[i]; i++) {
+        gchar **pair = g_strsplit(parts[i], "=", 2);
+        char *key = pair[0];
+        char *val = pair[1];
+        if (!val) {
+            g_strfreev(pair);
+            continue;
+        }
+        if (strcmp(key, "state") == 0) {
+            strncpy(job->state, val, MAX_LENGTH_STATE - 1);
+        } else if (strcmp(key, "start") == 0) {
+            job->stats.start = atof(val);
+        } else if (strcmp(key, "end") == 0) {
+            job->stats.end = atof(val);
+        } else if (strcmp(key, "remain_tasks") == 0) {
+            job->remain_tasks = atoi(val);
+        } else if (strcmp(key, "task_states") == 0) {
+            parse_int_array(val, job->task_states, MAX_NUM_TASKS);
+        } else if (strcmp(key, "task_remainwork") == 0) {
+            parse_int_array(val, job->task_remainwork, MAX_NUM_TASKS);
+        } else if (strcmp(key, "task_created") == 0) {
+            parse_task_times(val, job, offsetof(TaskStat, created));
+        } else if (strcmp(key, "task_start") == 0) {
+            parse_task_times(val, job, offsetof(TaskStat, start));
+        } else if (strcmp(key, "task_end") == 0) {
+            parse_task_times(val, job, offsetof(TaskStat, end));
+        }
+        g_strfreev(pair);
+    }
+    resolve_task_deps(job);
+}
+
+static void restore_work(Workunit *work, gchar **parts) {
+    for (int i = 1; parts[i]; i++) {
+        gchar **pair = g_strsplit(parts[i], "=", 2);
+        if (pair[1]) {
+            if (strcmp(pair[0], "done") == 0 && atoi(pair[1])) {
+                work_runs[work->idx].state = WORK_DONE;
+            } else if (strcmp(pair[0], "created") == 0) {
+                work_runs[work->idx].st_created = atof(pair[1]);
+            } else if (strcmp(pair[0], "checkout") == 0) {
+                work_runs[work->idx].st_checkout = atof(pair[1]);
+            }
+        }
+        g_strfreev(pair);
+    }
+}
+
+/* value of the first field "key=value" of a line split at ';' */
+static char* first_value(gchar **parts) {
+    char *eq = strchr(parts[0], '=');
+    return eq ? eq + 1 : "";
+}
+
+/* apply a checkpoint to the freshly parsed job_map and work_map. the run then
+ * continues from the checkpoint time: now_sec() counts from sim_offset */
+void checkpoint_load(char* path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    char *line = malloc(MAX_LEN_CKPT_LINE);
+    int jobs_loaded = 0;
+    int num_queued = 0;
+    int num_cached = 0;
+    while (fgets(line, MAX_LEN_CKPT_LINE, f) != NULL) {
+        g_strstrip(line);
+        gchar **parts = g_strsplit(line, ";", 30);
+        if (!parts[0]) {
+            g_strfreev(parts);
+            continue;
+        }
+        char *id = first_value(parts);
+        if (g_str_has_prefix(parts[0], "checkpoint=")) {
+            for (int i = 1; parts[i]; i++) {
+                if (g_str_has_prefix(parts[i], "time=")) {
+                    sim_offset = atof(parts[i] + strlen("time="));
+                }
+            }
+        } else if (g_str_has_prefix(parts[0], "job=")) {
+            Job *job = g_hash_table_lookup(job_map, id);
+            if (job) {
+                restore_job(job, parts);
+                jobs_loaded += 1;
+            }
+        } else if (g_str_has_prefix(parts[0], "work=")) {
+            Workunit *work = g_hash_table_lookup(work_map, id);
+            if (work) {
+                restore_work(work, parts);
+            }
+        } else if (g_str_has_prefix(parts[0], "queue=") && parts[1] && g_str_has_prefix(parts[1], "work=")) {
+            int s = atoi(id);
+            Workunit *work = g_hash_table_lookup(work_map, parts[1] + strlen("work="));
+            if (work && s >= 0 && s < MAX_NUM_SITES) {
+                if (!restored_queue[s]) {
+                    restored_queue[s] = g_queue_new();
+                }
+                g_queue_push_tail(restored_queue[s], strdup(work->id));
+                work_runs[work->idx].state = WORK_QUEUED;
+                num_queued += 1;
+            }
+        } else if (g_str_has_prefix(parts[0], "cache=") && parts[1] && parts[2]) {
+            if (!restored_caches) {
+                restored_caches = g_hash_table_new(g_direct_hash, g_direct_equal);
+            }
+            gpointer lp_key = GSIZE_TO_POINTER(strtoull(id, NULL, 10));
+            GQueue *entries = g_hash_table_lookup(restored_caches, lp_key);
+            if (!entries) {
+                entries = g_queue_new();
+                g_hash_table_insert(restored_caches, lp_key, entries);
+            }
+            /* size=<n>;obj=<name> -> "<n>:<name>" */
+            g_queue_push_tail(entries, g_strdup_printf("%s:%s", parts[1] + strlen("size="), parts[2] + strlen("obj=")));
+            num_cached += 1;
+        }
+        g_strfreev(parts);
+    }
+    free(line);
+    fclose(f);
+    printf("[checkpoint]restarting at time=%lf from %s: %d jobs in progress or done, %d workunits queued, %d cached objects\n",
+        sim_offset, path, jobs_loaded, num_queued, num_cached);
+}
+
+/* time a workunit holds a client: observed transfer times plus runtime */
+static double get_work_duration(Workunit *work) {
+    int w = work->idx;
+    return work_params.time_predata_in[w] + work_params.time_data_in[w] + work_params.runtime[w] + work_params.time_data_out[w];
+}
+
+/* start the run at offset sec into the trace with the state implied by the
+ * jobs that arrived before it, estimated from the trace alone: every task
+ * starts once its parents are done and all its workunits run at once, as
+ * with unlimited clients. jobs done by the offset are dropped from job_map
+ * and work_map; workunits running at the offset are requeued at restart.
+ * queues are therefore a lower bound, restart from a checkpoint recorded at
+ * the offset (--checkpoint-at) where the backlog matters */
+void warm_start_from_trace(double offset) {
+    int num_dropped = 0;
+    int num_active = 0;
+    int num_running = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, job_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Job* job = (Job*)value;
+        double arrival = etime_to_stime(job->stats.created);
+        if (fraction < 1.0) {
+            arrival *= fraction;
+        }
+        if (arrival >= offset) {
+            continue;
+        }
+        /* tasks in dependency order: each pass settles the tasks whose parents are settled */
+        double task_ready[MAX_NUM_TASKS];
+        double task_end[MAX_NUM_TASKS];
+        int settled = 0;
+        int num_settled = 0;
+        while (num_settled < job->num_tasks) {
+            int progress = 0;
+            for (int i = 0; i < job->num_tasks; i++) {
+                if ((settled & (1 << i)) || (job->task_parents[i] & ~settled)) {
+                    continue;
+                }
+                task_ready[i] = arrival;
+                for (int j = 0; j < job->num_tasks; j++) {
+                    if ((job->task_parents[i] & (1 << j)) && task_end[j] > task_ready[i]) {
+                        task_ready[i] = task_end[j];
+                    }
+                }
+                task_end[i] = task_ready[i];
+                int first = job->task_splits[i] == 1 ? 0 : 1;
+                for (int r = first; r < first + job->task_splits[i]; r++) {
+                    char work_id[MAX_LENGTH_ID];
+                    sprintf(work_id, "%s_%d_%d", job->id, i, r);
+                    Workunit* work = g_hash_table_lookup(work_map, work_id);
+                    double end = task_ready[i] + get_work_duration(work);
+                    if (end > task_end[i]) {
+                        task_end[i] = end;
+                    }
+                }
+                settled |= 1 << i;
+                num_settled += 1;
+                progress = 1;
+            }
+            assert(progress);  /* dependencies are acyclic */
+        }
+        double job_end = arrival;
+        for (int i = 0; i < job->num_tasks; i++) {
+            if (task_end[i] > job_end) {
+                job_end = task_end[i];
+            }
+        }
+
+        if (job_end <= offset) {
+            for (int i = 0; i < job->num_tasks; i++) {
+                int first = job->task_splits[i] == 1 ? 0 : 1;
+                for (int r = first; r < first + job->task_splits[i]; r++) {
+                    char work_id[MAX_LENGTH_ID];
+                    sprintf(work_id, "%s_%d_%d", job->id, i, r);
+                    g_hash_table_remove(work_map, work_id);
+                }
+            }
+            g_hash_table_iter_remove(&iter);
+            num_dropped += 1;
+            continue;
+        }
+
+        strcpy(job->state, "submitted");
+        job->stats.start = arrival;
+        for (int i = 0; i < job->num_tasks; i++) {
+            if (task_ready[i] > offset) {
+                continue;  /* still pending */
+            }
+            job->task_stats[i].created = task_ready[i];
+            job->task_stats[i].start = task_ready[i];
+            if (task_end[i] <= offset) {
+                job->task_states[i] = 2;
+                job->task_remainwork[i] = 0;
+                job->task_stats[i].end = task_end[i];
+                job->remain_tasks -= 1;
+                continue;
+            }
+            job->task_states[i] = 1;
+            int first = job->task_splits[i] == 1 ? 0 : 1;
+            for (int r = first; r < first + job->task_splits[i]; r++) {
+                char work_id[MAX_LENGTH_ID];
+                sprintf(work_id, "%s_%d_%d", job->id, i, r);
+                Workunit* work = g_hash_table_lookup(work_map, work_id);
+                work_runs[work->idx].st_created = task_ready[i];
+                if (task_ready[i] + get_work_duration(work) <= offset) {
+                    work_runs[work->idx].state = WORK_DONE;
+                    job->task_remainwork[i] -= 1;
+                } else {
+                    num_running += 1;
+                }
+            }
+        }
+        resolve_task_deps(job);
+        num_active += 1;
+    }
+    sim_offset = offset;
+    printf("[checkpoint]warm start at time=%lf: %d jobs done before and dropped, %d jobs in progress with %d running workunits to requeue\n",
+        offset, num_dropped, num_active, num_running);
+}
@@ -0,0 +1,42 @@
+/*
+ * File:   checkpoint.h
+ *
+ * Checkpoint and restart at a simulated-time boundary. A checkpoint holds
+ * the progress of every submitted job (task states, remaining workunits,
+ * timestamps), the done workunits, the order of every server queue and the
+ * contents of the object caches.
+ *
+ * Pending events are not serialized: on restart they are rebuilt from that
+ * state. Jobs arriving later are submitted from the trace, queued workunits
+ * are put back in their queue order, and workunits that were checked out or
+ * about to be enqueued at checkpoint time are requeued ahead of them, i.e.
+ * in-flight work runs again from the start. Counters and latency histograms
+ * cover the restarted run only.
+ *
+ * A warm start builds the same state from the trace alone instead of a
+ * checkpoint, see warm_start_from_trace().
+ *
+ * Created on July 1, 2014, 2:15 PM
+ */
+
+#ifndef CHECKPOINT_H
+#define	CHECKPOINT_H
+
+#include "glib.h"
+#include "ross.h"
+#include "obj_cache.h"
+
+extern int checkpoint_at;  //sim time in sec to write a checkpoint at, 0: no checkpoint
+extern int checkpoint_stop;  //end the run once the checkpoint is written
+extern char checkpoint_file_name[256];
+extern char restart_file_name[256];
+extern int warm_start;  //sim time in sec into the trace to start at, 0: start at the first arrival
+
+void checkpoint_register_server(int server_idx, GQueue* work_queue);
+void checkpoint_register_cache(tw_lpid lp_id, ObjCache *cache);
+void checkpoint_write(double now);
+void checkpoint_load(char* path);
+void warm_start_from_trace(double offset);
+GQueue* checkpoint_take_queue(int server_idx);
+
+#endif	/* CHECKPOINT_H */
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "critpath.h"
+#include "pqueue.h"
+#include "work_table.h"
+#include "lp_awe_server.h"
+#include "predict.h"
+#include "capability.h"
+#include "util.h"
+
+struct CritPath {
+    PQueue *heap;       /* queued workunits, longest remaining path first */
+    uint64_t version;   /* prediction version the ranks of the queued workunits are from */
+};
+
+/* per task, indexed job idx * MAX_NUM_TASKS + task, gathered once from the work table */
+typedef struct TaskAgg TaskAgg;
+struct TaskAgg {
+    Workunit *work;       /* one of its workunits, for the cmd */
+    int n;                /* workunits */
+    double input_mb;      /* mean input size */
+    double oracle_cost;   /* mean trace runtime plus transfer times */
+};
+
+static double *task_rank = NULL;  /* job idx * MAX_NUM_TASKS + task -> upward rank in sec */
+static TaskAgg *task_agg = NULL;
+static uint64_t *job_version = NULL;  /* job idx -> prediction version of its ranks, 0: not ranked */
+static uint64_t push_seq = 0;
+
+static void gather_tasks() {
+    task_agg = calloc((size_t)num_jobs * MAX_NUM_TASKS, sizeof(TaskAgg));
+    for (int w = 0; w < num_works; w++) {
+        Workunit *work = get_work(w);
+        TaskAgg *t = &task_agg[(size_t)work->job_idx * MAX_NUM_TASKS + work->stage];
+        t->work = work;
+        t->n++;
+        t->input_mb += work_params.size_infile[w] / (double)Mega;
+        t->oracle_cost += work_params.runtime[w] + work_params.time_data_in[w] + work_params.time_data_out[w] + work_params.time_predata_in[w];
+    }
+    for (size_t i = 0; i < (size_t)num_jobs * MAX_NUM_TASKS; i++) {
+        if (task_agg[i].n > 0) {
+            task_agg[i].input_mb /= task_agg[i].n;
+            task_agg[i].oracle_cost /= task_agg[i].n;
+        }
+    }
+}
+
+/* predicted runtime of the task's workunits at their mean input size, with
+ * --predict-oracle their mean trace runtime plus transfer times */
+static double task_cost(Job *job, int task) {
+    TaskAgg *t = &task_agg[(size_t)job->idx * MAX_NUM_TASKS + task];
+    if (t->n == 0) {
+        return 0;
+    }
+    return predict_oracle ? t->oracle_cost : predict_runtime_at(t->work, t->input_mb);
+}
+
+static double upward_rank(Job *job, int task, double *rank, double *cost) {
+    if (rank[task] >= 0) {
+        return rank[task];
+    }
+    double longest = 0;
+    for (int c = 0; c < job->num_tasks; c++) {
+        if ((job->task_parents[c] >> task) & 1) {
+            double r = upward_rank(job, c, rank, cost);
+            if (r > longest) {
+                longest = r;
+            }
+        }
+    }
+    rank[task] = cost[task] + longest;
+    return rank[task];
+}
+
+static void rank_job(Job *job) {
+    double *rank = &task_rank[(size_t)job->idx * MAX_NUM_TASKS];
+    double cost[MAX_NUM_TASKS];
+    for (int t = 0; t < job->num_tasks; t++) {
+        cost[t] = task_cost(job, t);
+        rank[t] = -1;
+    }
+    for (int t = 0; t < job->num_tasks; t++) {
+        upward_rank(job, t, rank, cost);
+    }
+    job_version[job->idx] = predict_version();
+}
+
+static void rank_if_stale(Job *job) {
+    if (job_version[job->idx] != predict_version()) {
+        rank_job(job);
+    }
+}
+
+double cp_rank(Workunit *work) {
+    return task_rank[(size_t)work->job_idx * MAX_NUM_TASKS + work->stage];
+}
+
+static int work_before(const void *a, const void *b) {
+    const Workunit *wa = a;
+    const Workunit *wb = b;
+    double ra = cp_rank((Workunit*)wa);
+    double rb = cp_rank((Workunit*)wb);
+    if (ra != rb) {
+        return ra > rb;
+    }
+    return work_runs[wa->idx].queue_seq < work_runs[wb->idx].queue_seq;
+}
+
+static void work_set_pos(void *item, int pos) {
+    work_runs[((Workunit*)item)->idx].heap_pos = pos;
+}
+
+CritPath* cp_new() {
+    if (!task_rank) {
+        task_rank = calloc((size_t)num_jobs * MAX_NUM_TASKS, sizeof(double));
+        job_version = calloc(num_jobs, sizeof(uint64_t));
+        gather_tasks();
+    }
+    CritPath *cp = malloc(sizeof(CritPath));
+    cp->heap = pq_new(work_before, work_set_pos);
+    cp->version = predict_version();
+    return cp;
+}
+
+/* after the predictions changed, rank the jobs of the queued workunits again
+ * and restore the heap order. Another heap may have re-ranked a job already,
+ * so a heap is only valid at the version it was last refreshed at */
+static void refresh(CritPath *cp) {
+    uint64_t version = predict_version();
+    if (cp->version == version) {
+        return;
+    }
+    for (int i = 0; i < cp->heap->size; i++) {
+        rank_if_stale(get_job(((Workunit*)cp->heap->items[i])->job_idx));
+    }
+    pq_heapify(cp->heap);
+    cp->version = version;
+}
+
+/* at_head: first among the workunits of the same rank */
+void cp_push(CritPath *cp, Workunit *work, int at_head) {
+    refresh(cp);
+    rank_if_stale(get_job(work->job_idx));
+    work_runs[work->idx].queue_seq = at_head ? 0 : ++push_seq;
+    pq_push(cp->heap, work);
+}
+
+static int class_match(const void *item, const void *arg) {
+    return cap_class_match(*(const int*)arg, (Workunit*)item);
+}
+
+/* the workunit on the longest remaining path a client of class cls can run,
+ * -1: any class */
+Workunit* cp_pop(CritPath *cp, int cls) {
+    refresh(cp);
+    return cls < 0 ? pq_pop(cp->heap) : pq_pop_match(cp->heap, class_match, &cls);
+}
+
+/* take a queued workunit out, when it is stolen */
+void cp_remove(CritPath *cp, Workunit *work) {
+    refresh(cp);
+    pq_remove(cp->heap, work_runs[work->idx].heap_pos);
+}
@@ -0,0 +1,39 @@
+/*
+ * File:   critpath.h
+ *
+ * Critical-path scheduling (sched_policy 5). When the first workunit of a
+ * job is queued every task of the job gets its upward rank,
+ *   rank(t) = cost(t) + max rank(c) over the children c of t,
+ * the remaining critical path of the job from the start of t, with cost(t)
+ * the predicted runtime (see predict.h) at the mean input size of its
+ * workunits, or with --predict-oracle their mean trace runtime plus transfer
+ * times. Workunit counts and mean input sizes per task are gathered once
+ * from the work table, so ranking a job only touches its tasks. The rank only
+ * depends on the downstream tasks, so it stays valid as tasks complete: the
+ * remaining critical path of a job is the rank of its ready tasks. When the
+ * prediction version moved, the jobs of the queued workunits are ranked
+ * again before the next heap operation. Each awe_server keeps its queued
+ * workunits in a heap by rank, FIFO on ties, and hands out the one on the
+ * longest remaining path.
+ *
+ * Created on July 25, 2014, 9:50 AM
+ */
+
+#ifndef CRITPATH_H
+#define	CRITPATH_H
+
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+#define SCHED_CRITPATH 5
+
+typedef struct CritPath CritPath;
+
+CritPath* cp_new();
+double cp_rank(Workunit *work);
+void cp_push(CritPath *cp, Workunit *work, int at_head);
+Workunit* cp_pop(CritPath *cp, int cls);
+void cp_remove(CritPath *cp, Workunit *work);
+
+#endif	/* CRITPATH_H */
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "failure.h"
+#include "util.h"
+#include "awe_types.h"
+#include "codes/codes.h"
+
+char failure_spec[256] = {0};
+char outage_file_name[256] = {0};
+int lease_timeout = 0;
+int work_ckpt_interval = 0;
+int work_ckpt_cost = 0;
+
+FailureStats failure_stats;
+
+typedef struct FailureProc FailureProc;
+struct FailureProc {
+    double mtbf;   /* in sec, 0: no failures */
+    double mttr;
+};
+
+typedef struct Outage Outage;
+struct Outage {
+    int site;
+    int client;    /* index within the site, -1: all */
+    double start;  /* epoch sec */
+    double end;
+};
+
+static FailureProc site_failure[MAX_NUM_SITES];
+static Outage *outages = NULL;
+static int num_outages = 0;
+static GHashTable *client_health = NULL;  /* client lp id -> ClientHealth */
+
+static void parse_failure_spec() {
+    int site_set[MAX_NUM_SITES] = {0};
+    gchar **entries = g_strsplit(failure_spec, ",", MAX_NUM_SITES + 1);
+    /* entries for all sites first, so that site entries override them wherever they are listed */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; entries[i]; i++) {
+            gchar **f = g_strsplit(entries[i], ":", 4);
+            int n = g_strv_length(f);
+            int has_site = n == 3;
+            if (n < 2 || n > 3) {
+                fprintf(stderr, "bad failure entry \"%s\", see failure.h\n", entries[i]);
+                exit(1);
+            }
+            if (has_site == pass) {
+                FailureProc fp = {atof(f[has_site]), atof(f[has_site + 1])};
+                for (int s = 0; s < MAX_NUM_SITES; s++) {
+                    if (has_site ? s == atoi(f[0]) : !site_set[s]) {
+                        site_failure[s] = fp;
+                        site_set[s] = has_site;
+                    }
+                }
+            }
+            g_strfreev(f);
+        }
+    }
+    g_strfreev(entries);
+}
+
+static void load_outage_file() {
+    FILE *f = fopen(outage_file_name, "r");
+    if (f == NULL) {
+        perror(outage_file_name);
+        exit(1);
+    }
+    char line[MAX_LEN_TRACE_LINE];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        g_strstrip(line);
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+        Outage o;
+        if (sscanf(line, "%d %d %lf %lf", &o.site, &o.client, &o.start, &o.end) != 4 || o.end <= o.start) {
+            fprintf(stderr, "bad outage \"%s\" in %s, see failure.h\n", line, outage_file_name);
+            exit(1);
+        }
+        outages = realloc(outages, sizeof(Outage) * (num_outages + 1));
+        outages[num_outages++] = o;
+    }
+    fclose(f);
+    printf("[failure]%d outages loaded from %s\n", num_outages, outage_file_name);
+}
+
+void failure_init() {
+    memset(&failure_stats, 0, sizeof(FailureStats));
+    memset(site_failure, 0, sizeof(site_failure));
+    if (failure_spec[0]) {
+        parse_failure_spec();
+    }
+    if (outage_file_name[0]) {
+        load_outage_file();
+    }
+    if (failure_enabled() && lease_timeout <= 0) {
+        lease_timeout = 600;
+    }
+}
+
+int failure_enabled() {
+    return failure_spec[0] || outage_file_name[0];
+}
+
+ClientHealth* failure_register_client(tw_lpid client_id) {
+    if (!client_health) {
+        client_health = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    ClientHealth *h = g_new0(ClientHealth, 1);
+    g_hash_table_insert(client_health, GSIZE_TO_POINTER(client_id), h);
+    return h;
+}
+
+static void plan_client_event(tw_lp *lp, awe_event_type event_type, tw_stime offset, int from_process) {
+    tw_event *e = codes_event_new(lp->gid, offset, lp);
+    awe_msg *msg = tw_event_data(e);
+    msg->event_type = event_type;
+    msg->src = lp->gid;
+    msg->count = from_process;
+    tw_event_send(e);
+}
+
+/* first failure of the MTBF process and the outages of the client */
+void failure_plan_client(int site, int idx, tw_lp *lp) {
+    double ttf = failure_time_to_fail(site, lp);
+    if (ttf >= 0) {
+        plan_client_event(lp, CLIENT_FAIL, s_to_ns(ttf), 1);
+    }
+    for (int i = 0; i < num_outages; i++) {
+        Outage *o = &outages[i];
+        /* the trace sets kickoff_epoch_time, so convert only now */
+        double start = etime_to_stime(o->start) - sim_offset;
+        double end = etime_to_stime(o->end) - sim_offset;
+        if (o->site != site || (o->client >= 0 && o->client != idx) || end <= 0) {
+            continue;
+        }
+        plan_client_event(lp, CLIENT_FAIL, s_to_ns(start > 0 ? start : 0) + g_tw_lookahead, 0);
+        plan_client_event(lp, CLIENT_RECOVER, s_to_ns(end) + g_tw_lookahead, 0);
+    }
+}
+
+/* in sec, -1 if clients of the site do not fail on their own */
+double failure_time_to_fail(int site, tw_lp *lp) {
+    if (site < 0 || site_failure[site].mtbf <= 0) {
+        return -1;
+    }
+    return tw_rand_exponential(lp->rng, site_failure[site].mtbf);
+}
+
+double failure_time_to_repair(int site, tw_lp *lp) {
+    return tw_rand_exponential(lp->rng, site_failure[site].mttr);
+}
+
+int failure_client_epoch(tw_lpid client_id) {
+    ClientHealth *h = client_health ? g_hash_table_lookup(client_health, GSIZE_TO_POINTER(client_id)) : NULL;
+    return h ? h->epoch : 0;
+}
+
+/* a lease taken at epoch is still renewed by the client */
+int failure_lease_valid(tw_lpid client_id, int epoch) {
+    ClientHealth *h = client_health ? g_hash_table_lookup(client_health, GSIZE_TO_POINTER(client_id)) : NULL;
+    return !h || (h->down == 0 && h->epoch == epoch);
+}
+
+void failure_report() {
+    if (!failure_enabled() && work_ckpt_interval <= 0) {
+        return;
+    }
+    printf("[failure]failures=%llu,requeued=%llu,lost_compute=%lf,down_time=%lf,ckpt_overhead=%lf,lease_timeout=%d\n",
+        (unsigned long long)failure_stats.num_failures,
+        (unsigned long long)failure_stats.num_requeued,
+        failure_stats.lost_compute,
+        failure_stats.down_time,
+        failure_stats.ckpt_overhead,
+        lease_timeout);
+}
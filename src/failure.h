@@ -0,0 +1,68 @@
+/*
+ * File:   failure.h
+ *
+ * Client failures and preemption. A failed client loses the workunit it runs
+ * and ignores everything sent to it until it is repaired, then asks for work
+ * again. Failures come from a per-site MTBF/MTTR process given by --failures
+ * as a comma separated list of [site:]mtbf:mttr entries in seconds, both
+ * exponentially distributed, an entry without site applying to all other
+ * sites, e.g. --failures=1:7200:300. An outage file adds failures from logs,
+ * one per line:
+ *   site client start end
+ * with the client index within the site (-1: all clients of the site) and
+ * start/end in epoch seconds like the job trace.
+ *
+ * The server gives every checked out copy a lease of --lease-timeout seconds.
+ * The client renews it as long as it stays up (heartbeats, not simulated as
+ * events); a lease that expires on a client that failed meanwhile requeues
+ * the workunit as a new copy.
+ *
+ * With --work-ckpt-interval a workunit writes a checkpoint after every that
+ * many seconds of compute, taking --work-ckpt-cost seconds each, and a copy
+ * started after a failure resumes from the last one.
+ *
+ * Created on July 17, 2014, 10:15 AM
+ */
+
+#ifndef FAILURE_H
+#define	FAILURE_H
+
+#include <stdint.h>
+#include "ross.h"
+
+extern char failure_spec[256];
+extern char outage_file_name[256];
+extern int lease_timeout;       //in sec, 0: leases never expire (600 if failures are on)
+extern int work_ckpt_interval;  //compute sec between workunit checkpoints, 0: no checkpoints
+extern int work_ckpt_cost;      //sec to write one workunit checkpoint
+
+/* up/down state of a client, shared with the server that checks its leases */
+typedef struct ClientHealth ClientHealth;
+struct ClientHealth {
+    int down;    /* overlapping failures in effect, 0: up */
+    int epoch;   /* failures and checkouts lost while down so far, ends the leases taken before */
+    tw_stime down_ts;
+};
+
+typedef struct FailureStats FailureStats;
+struct FailureStats {
+    uint64_t num_failures;
+    uint64_t num_requeued;     /* copies lost on failed clients and requeued at lease expiry */
+    double lost_compute;       /* compute sec lost on failed clients, after checkpoints */
+    double down_time;          /* client sec down */
+    double ckpt_overhead;      /* compute sec spent writing workunit checkpoints */
+};
+
+extern FailureStats failure_stats;
+
+void failure_init();
+int failure_enabled();
+ClientHealth* failure_register_client(tw_lpid client_id);
+void failure_plan_client(int site, int idx, tw_lp *lp);
+double failure_time_to_fail(int site, tw_lp *lp);
+double failure_time_to_repair(int site, tw_lp *lp);
+int failure_client_epoch(tw_lpid client_id);
+int failure_lease_valid(tw_lpid client_id, int epoch);
+void failure_report();
+
+#endif	/* FAILURE_H */
@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "fairshare.h"
+#include "pqueue.h"
+#include "work_table.h"
+#include "lp_awe_server.h"
+#include "util.h"
+#include "capability.h"
+
+int fs_halflife = 86400;
+int fs_project_weight = 1;
+
+typedef struct FsProject FsProject;
+typedef struct FsGroup FsGroup;
+typedef struct FsUser FsUser;
+typedef struct FsQueue FsQueue;
+
+struct FsProject {
+    const char *name;
+    double usage;       /* decayed, scaled to decay_ref */
+    FsGroup *group[MAX_NUM_SITES];
+};
+
+/* the queues of one project on one server. the project usage is the same for
+ * all of them, so they are ordered by user usage alone, and a charge to the
+ * project moves only the group in the server heap */
+struct FsGroup {
+    FsProject *project;
+    FairShare *fs;
+    PQueue *heap;       /* non-empty FsQueues of the project */
+    int pos;            /* in fs->heap, -1 while empty */
+};
+
+struct FsUser {
+    const char *name;
+    FsProject *project;
+    double usage;       /* decayed, scaled to decay_ref */
+    double total;       /* client sec, not decayed */
+    int jobs_done;
+    double turnaround_sum;
+    GSList *queues;     /* all FsQueues of the user, over servers and classes */
+    FsQueue *queue[MAX_NUM_SITES][FS_NUM_CLASSES];
+};
+
+struct FsQueue {
+    FsUser *user;
+    FsGroup *group;
+    int cls;
+    GQueue works;
+    int pos;            /* in group->heap, -1 while empty */
+    uint64_t last_served;
+};
+
+struct FairShare {
+    int id;
+    PQueue *heap;       /* FsGroups with queued workunits */
+};
+
+static GHashTable *users = NULL;     /* name -> FsUser */
+static GHashTable *projects = NULL;  /* name -> FsProject */
+static FsUser **job_users = NULL;    /* job idx -> FsUser */
+static int num_fs = 0;
+static uint64_t serve_seq = 0;
+static double decay_ref = 0;         /* usage values are scaled to this sim time */
+static double exec_sum = 0;
+static uint64_t exec_count = 0;
+
+static double usage_key(const FsQueue *q) {
+    return fs_project_weight * q->user->project->usage + q->user->usage;
+}
+
+/* within a group, where the project usage is the same */
+static int queue_less(const void *a, const void *b) {
+    const FsQueue *qa = a;
+    const FsQueue *qb = b;
+    if (qa->cls != qb->cls) {
+        return qa->cls > qb->cls;
+    }
+    if (qa->user->usage != qb->user->usage) {
+        return qa->user->usage < qb->user->usage;
+    }
+    return qa->last_served < qb->last_served;
+}
+
+/* groups by their first queue */
+static int group_less(const void *a, const void *b) {
+    const FsQueue *qa = pq_peek(((FsGroup*)a)->heap);
+    const FsQueue *qb = pq_peek(((FsGroup*)b)->heap);
+    if (qa->cls != qb->cls) {
+        return qa->cls > qb->cls;
+    }
+    double ka = usage_key(qa);
+    double kb = usage_key(qb);
+    if (ka != kb) {
+        return ka < kb;
+    }
+    return qa->last_served < qb->last_served;
+}
+
+static void queue_set_pos(void *item, int pos) {
+    ((FsQueue*)item)->pos = pos;
+}
+
+static void group_set_pos(void *item, int pos) {
+    ((FsGroup*)item)->pos = pos;
+}
+
+/* put the group back in order after its first queue or the project usage changed */
+static void group_update(FsGroup *g) {
+    if (g->heap->size == 0) {
+        if (g->pos >= 0) {
+            pq_remove(g->fs->heap, g->pos);
+        }
+    } else if (g->pos < 0) {
+        pq_push(g->fs->heap, g);
+    } else {
+        pq_update(g->fs->heap, g->pos);
+    }
+}
+
+static FsUser* job_user(Job *job) {
+    if (!job_users) {
+        job_users = calloc(num_jobs, sizeof(FsUser*));
+        users = g_hash_table_new(g_str_hash, g_str_equal);
+        projects = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    if (job_users[job->idx]) {
+        return job_users[job->idx];
+    }
+    FsUser *user = g_hash_table_lookup(users, job->username);
+    if (!user) {
+        FsProject *project = g_hash_table_lookup(projects, job->project);
+        if (!project) {
+            project = calloc(1, sizeof(FsProject));
+            project->name = job->project;
+            g_hash_table_insert(projects, job->project, project);
+        }
+        user = calloc(1, sizeof(FsUser));
+        user->name = job->username;
+        user->project = project;
+        g_hash_table_insert(users, job->username, user);
+    }
+    job_users[job->idx] = user;
+    return user;
+}
+
+static int job_class(Job *job) {
+    return job->priority < 0 ? 0 : job->priority >= FS_NUM_CLASSES ? FS_NUM_CLASSES - 1 : job->priority;
+}
+
+FairShare* fs_new() {
+    assert(num_fs < MAX_NUM_SITES);
+    FairShare *fs = calloc(1, sizeof(FairShare));
+    fs->id = num_fs++;
+    fs->heap = pq_new(group_less, group_set_pos);
+    return fs;
+}
+
+static FsQueue* get_queue(FairShare *fs, Workunit *work) {
+    Job *job = get_job(work->job_idx);
+    FsUser *user = job_user(job);
+    int cls = job_class(job);
+    FsQueue *q = user->queue[fs->id][cls];
+    if (!q) {
+        FsGroup *g = user->project->group[fs->id];
+        if (!g) {
+            g = calloc(1, sizeof(FsGroup));
+            g->project = user->project;
+            g->fs = fs;
+            g->heap = pq_new(queue_less, queue_set_pos);
+            g->pos = -1;
+            user->project->group[fs->id] = g;
+        }
+        q = calloc(1, sizeof(FsQueue));
+        q->user = user;
+        q->group = g;
+        q->cls = cls;
+        q->pos = -1;
+        g_queue_init(&q->works);
+        user->queue[fs->id][cls] = q;
+        user->queues = g_slist_prepend(user->queues, q);
+    }
+    return q;
+}
+
+void fs_push(FairShare *fs, Workunit *work, int at_head) {
+    FsQueue *q = get_queue(fs, work);
+    if (at_head) {
+        g_queue_push_head(&q->works, work);
+        work_runs[work->idx].fs_link = g_queue_peek_head_link(&q->works);
+    } else {
+        g_queue_push_tail(&q->works, work);
+        work_runs[work->idx].fs_link = g_queue_peek_tail_link(&q->works);
+    }
+    if (q->pos < 0) {
+        pq_push(q->group->heap, q);
+        group_update(q->group);
+    }
+}
+
+/* serve the workunit at link of the queue */
+static Workunit* take(FsQueue *q, GList *link) {
+    Workunit *work = link->data;
+    g_queue_delete_link(&q->works, link);
+    work_runs[work->idx].fs_link = NULL;
+    q->last_served = ++serve_seq;
+    if (g_queue_is_empty(&q->works)) {
+        pq_remove(q->group->heap, q->pos);
+    } else {
+        pq_update(q->group->heap, q->pos);
+    }
+    group_update(q->group);
+    return work;
+}
+
+/* the first workunit of the queue a client of class cls can run */
+static GList* first_match(FsQueue *q, int cls) {
+    GList *link = g_queue_peek_head_link(&q->works);
+    while (link && !cap_class_match(cls, link->data)) {
+        link = link->next;
+    }
+    return link;
+}
+
+/* the queues in the order fs_pop serves them, until one holds a workunit the
+ * class can run. groups and queues passed over are pushed back unchanged */
+static Workunit* pop_class(FairShare *fs, int cls) {
+    GSList *groups = NULL;
+    FsQueue *q = NULL;
+    GList *link = NULL;
+    FsGroup *g;
+    while (!link && (g = pq_pop(fs->heap))) {
+        groups = g_slist_prepend(groups, g);
+        GSList *queues = NULL;
+        while (!link && (q = pq_pop(g->heap))) {
+            queues = g_slist_prepend(queues, q);
+            link = first_match(q, cls);
+        }
+        for (GSList *l = queues; l; l = l->next) {
+            pq_push(g->heap, l->data);
+        }
+        g_slist_free(queues);
+    }
+    for (GSList *l = groups; l; l = l->next) {
+        pq_push(fs->heap, l->data);
+    }
+    g_slist_free(groups);
+    return link ? take(q, link) : NULL;
+}
+
+/* the next workunit by priority class and usage a client of class cls can
+ * run, -1: any class. NULL if none is queued */
+Workunit* fs_pop(FairShare *fs, int cls) {
+    FsGroup *g = pq_peek(fs->heap);
+    if (!g) {
+        return NULL;
+    }
+    FsQueue *q = pq_peek(g->heap);
+    if (cap_class_match(cls, g_queue_peek_head(&q->works))) {
+        return take(q, g_queue_peek_head_link(&q->works));
+    }
+    return pop_class(fs, cls);
+}
+
+/* take a queued workunit out, when it is stolen */
+void fs_remove(FairShare *fs, Workunit *work) {
+    WorkRun *run = &work_runs[work->idx];
+    if (!run->fs_link) {
+        return;
+    }
+    FsQueue *q = get_queue(fs, work);
+    g_queue_delete_link(&q->works, run->fs_link);
+    run->fs_link = NULL;
+    if (g_queue_is_empty(&q->works) && q->pos >= 0) {
+        pq_remove(q->group->heap, q->pos);
+        group_update(q->group);
+    }
+}
+
+/* decay multiplies every usage by the same factor and leaves the heaps in
+ * order, so it is applied by scaling new charges up instead. the scale is
+ * brought back to 1 before it overflows */
+static double decay_scale(double now) {
+    if (fs_halflife <= 0) {
+        return 1.0;
+    }
+    double scale = exp2((now - decay_ref) / fs_halflife);
+    if (scale > 1e100) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, users);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            ((FsUser*)value)->usage /= scale;
+        }
+        g_hash_table_iter_init(&iter, projects);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            ((FsProject*)value)->usage /= scale;
+        }
+        decay_ref = now;
+        scale = 1.0;
+    }
+    return scale;
+}
+
+/* a usage amount scaled to ref, rescaled to the current decay_ref */
+static double rebase(double amount, double ref) {
+    return fs_halflife <= 0 || ref == decay_ref ? amount : amount * exp2((ref - decay_ref) / fs_halflife);
+}
+
+/* add usage already scaled to decay_ref */
+static void charge(FsUser *user, double usage) {
+    user->usage += usage;
+    user->project->usage += usage;
+    /* the user's queues move within their groups, the groups of the project
+     * within the server heaps */
+    for (GSList *l = user->queues; l; l = l->next) {
+        FsQueue *q = l->data;
+        if (q->pos >= 0) {
+            pq_update(q->group->heap, q->pos);
+        }
+    }
+    for (int s = 0; s < num_fs; s++) {
+        FsGroup *g = user->project->group[s];
+        if (g && g->pos >= 0) {
+            pq_update(g->fs->heap, g->pos);
+        }
+    }
+}
+
+/* a copy goes to a client: charge what a workunit takes on average */
+void fs_work_started(Workunit *work, double now) {
+    WorkRun *run = &work_runs[work->idx];
+    double estimate = exec_count > 0 ? exec_sum / exec_count : 1.0;
+    double usage = estimate * decay_scale(now);
+    run->fs_charge = rebase(run->fs_charge, run->fs_charge_ref) + usage;
+    run->fs_charge_ref = decay_ref;
+    charge(job_user(get_job(work->job_idx)), usage);
+}
+
+/* replace the estimates charged for the workunit by its execution time */
+void fs_work_done(Workunit *work, double exec_sec, double now) {
+    WorkRun *run = &work_runs[work->idx];
+    FsUser *user = job_user(get_job(work->job_idx));
+    exec_sum += exec_sec;
+    exec_count += 1;
+    double usage = exec_sec * decay_scale(now);
+    charge(user, usage - rebase(run->fs_charge, run->fs_charge_ref));
+    user->total += exec_sec;
+    run->fs_charge = 0;
+}
+
+void fs_job_done(Job *job, double turnaround) {
+    FsUser *user = job_user(job);
+    user->jobs_done += 1;
+    user->turnaround_sum += turnaround;
+}
+
+/* per-user usage and turnaround, and Jain's fairness index of the mean turnarounds */
+void fs_report() {
+    if (!users || (g_hash_table_size(users) < 2 && sched_policy != SCHED_FAIRSHARE)) {
+        return;
+    }
+    double sum = 0, sum_sq = 0;
+    int n = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, users);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        FsUser *user = value;
+        double mean = user->jobs_done > 0 ? user->turnaround_sum / user->jobs_done : 0;
+        printf("[fairshare]user=%s,project=%s,jobs_done=%d,usage=%lf,turnaround_mean=%lf\n",
+            user->name[0] ? user->name : "-", user->project->name[0] ? user->project->name : "-", user->jobs_done, user->total, mean);
+        if (user->jobs_done > 0) {
+            sum += mean;
+            sum_sq += mean * mean;
+            n++;
+        }
+    }
+    printf("[fairshare]users=%u,projects=%u,turnaround_jain=%lf\n",
+        g_hash_table_size(users),
+        g_hash_table_size(projects),
+        sum_sq > 0 ? sum * sum / (n * sum_sq) : 1.0);
+}
@@ -0,0 +1,49 @@
+/*
+ * File:   fairshare.h
+ *
+ * Fair-share scheduling (sched_policy 4). Each awe_server keeps one FIFO of
+ * queued workunits per user and priority class, the non-empty ones in a heap
+ * per project and the projects in a heap by their first queue, so the next
+ * workunit is found, and a charge reordered, in O(log users) instead of a
+ * scan of the queue. It serves the highest priority class first, within a
+ * class the queue whose user has the lowest usage,
+ *   fs_project_weight * usage of the project + usage of the user
+ * and on ties the one served longest ago.
+ *
+ * Usage is in client sec and decays with a half-life of --fs-halflife sec.
+ * A copy handed to a client is charged the mean execution time seen so far,
+ * corrected to the actual time once the workunit is done, so that users are
+ * interleaved before anything finished.
+ *
+ * Job user, project and priority come from the job trace keys user (or
+ * username), project and priority. Per-user accounting and turnaround are
+ * reported under every policy, to compare fair-share against the others.
+ *
+ * Created on July 23, 2014, 2:40 PM
+ */
+
+#ifndef FAIRSHARE_H
+#define	FAIRSHARE_H
+
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+#define SCHED_FAIRSHARE 4
+#define FS_NUM_CLASSES 4   /* job priorities 0..FS_NUM_CLASSES-1, higher first */
+
+extern int fs_halflife;        //usage half-life in sec, 0: no decay
+extern int fs_project_weight;  //weight of the project usage against the user usage
+
+typedef struct FairShare FairShare;
+
+FairShare* fs_new();
+void fs_push(FairShare *fs, Workunit *work, int at_head);
+Workunit* fs_pop(FairShare *fs, int cls);
+void fs_remove(FairShare *fs, Workunit *work);
+void fs_work_started(Workunit *work, double now);
+void fs_work_done(Workunit *work, double exec_sec, double now);
+void fs_job_done(Job *job, double turnaround);
+void fs_report();
+
+#endif	/* FAIRSHARE_H */
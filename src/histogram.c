@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "histogram.h"
+#include "util.h"
+
+static const char* metric_names[NUM_LAT_METRICS] = {
+    "job_turnaround",
+    "task_queue_wait",
+    "work_wait",
+    "download",
+    "upload",
+    "work_exec",
+};
+
+static Histogram lat_all[NUM_LAT_METRICS];
+static Histogram lat_site[NUM_LAT_METRICS][MAX_NUM_SITES];
+static Histogram lat_stage[NUM_LAT_METRICS][MAX_NUM_TASKS];
+
+static int get_bucket(uint64_t v) {
+    if (v < (1 << HIST_SUB_BITS)) {
+        return (int)v;
+    }
+    int e = 63 - __builtin_clzll(v);  /* highest set bit, >= HIST_SUB_BITS */
+    int shift = e - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int)((v >> shift) & ((1 << HIST_SUB_BITS) - 1));
+}
+
+/* lowest value (in ms) falling into a bucket */
+static uint64_t get_bucket_floor(int bucket) {
+    int shift = (bucket >> HIST_SUB_BITS) - 1;
+    if (shift < 0) {
+        return bucket;
+    }
+    uint64_t mantissa = (1 << HIST_SUB_BITS) | (bucket & ((1 << HIST_SUB_BITS) - 1));
+    return mantissa << shift;
+}
+
+void hist_record(Histogram *h, double sec) {
+    if (sec < 0) {
+        sec = 0;
+    }
+    h->buckets[get_bucket((uint64_t)(sec * 1000))] += 1;
+    h->count += 1;
+    h->sum += sec;
+    if (sec > h->max) {
+        h->max = sec;
+    }
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+    for (int i = 0; i < HIST_NUM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/* value (in sec) below which a fraction p of the recorded values fall, taken
+ * as the middle of the bucket and capped by the recorded maximum */
+double hist_percentile(const Histogram *h, double p) {
+    if (h->count == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)(p * h->count);
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_NUM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            double lo = get_bucket_floor(i);
+            double hi = (i + 1 < HIST_NUM_BUCKETS) ? get_bucket_floor(i + 1) : lo;
+            double v = (lo + hi) / 2 / 1000.0;
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const Histogram *h) {
+    return h->count ? h->sum / h->count : 0.0;
+}
+
+/* record a latency, site and stage are -1 when not applicable */
+void latency_record(latency_metric metric, int site, int stage, double sec) {
+    hist_record(&lat_all[metric], sec);
+    if (site >= 0 && site < MAX_NUM_SITES) {
+        hist_record(&lat_site[metric][site], sec);
+    }
+    if (stage >= 0 && stage < MAX_NUM_TASKS) {
+        hist_record(&lat_stage[metric][stage], sec);
+    }
+}
+
+Histogram* latency_get(latency_metric metric) {
+    return &lat_all[metric];
+}
+
+Histogram* latency_get_stage(latency_metric metric, int stage) {
+    return &lat_stage[metric][stage];
+}
+
+static void print_hist(const char *metric, const char *scope, const Histogram *h) {
+    if (h->count == 0) {
+        return;
+    }
+    printf("[latency]metric=%s, scope=%s, count=%llu, mean=%lf, p50=%lf, p90=%lf, p99=%lf, max=%lf\n",
+        metric,
+        scope,
+        (unsigned long long)h->count,
+        hist_mean(h),
+        hist_percentile(h, 0.50),
+        hist_percentile(h, 0.90),
+        hist_percentile(h, 0.99),
+        h->max);
+}
+
+void latency_report() {
+    char scope[MAX_NAME_LENGTH_WKLD];
+    for (int m = 0; m < NUM_LAT_METRICS; m++) {
+        print_hist(metric_names[m], "all", &lat_all[m]);
+        for (int s = 0; s < get_num_sites(); s++) {
+            print_hist(metric_names[m], get_site_name(s), &lat_site[m][s]);
+        }
+        for (int t = 0; t < MAX_NUM_TASKS; t++) {
+            sprintf(scope, "stage_%d", t);
+            print_hist(metric_names[m], scope, &lat_stage[m][t]);
+        }
+    }
+}
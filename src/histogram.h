@@ -0,0 +1,50 @@
+/*
+ * File:   histogram.h
+ *
+ * Fixed-size log-bucketed histograms for latencies. A histogram records
+ * values in milliseconds into 2^HIST_SUB_BITS linear sub-buckets per power of
+ * two, so percentiles are within 1/2^HIST_SUB_BITS of the true value.
+ * Histograms of the same layout merge by adding their buckets.
+ *
+ * Created on June 20, 2014, 3:30 PM
+ */
+
+#ifndef HISTOGRAM_H
+#define	HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HIST_SUB_BITS 3
+#define HIST_NUM_BUCKETS ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct Histogram Histogram;
+struct Histogram {
+    uint64_t count;
+    double sum;   /* in sec */
+    double max;   /* in sec */
+    uint64_t buckets[HIST_NUM_BUCKETS];
+};
+
+void hist_record(Histogram *h, double sec);
+void hist_merge(Histogram *dst, const Histogram *src);
+double hist_percentile(const Histogram *h, double p);
+double hist_mean(const Histogram *h);
+
+/* latencies recorded during the simulation, broken down per site and per stage */
+typedef enum latency_metric latency_metric;
+enum latency_metric {
+    LAT_JOB_TURNAROUND,   /* job submitted -> last task done */
+    LAT_TASK_QUEUE_WAIT,  /* task ready -> first workunit checked out */
+    LAT_WORK_WAIT,        /* workunit enqueued -> checked out */
+    LAT_DOWNLOAD,         /* input download on the client */
+    LAT_UPLOAD,           /* output upload on the client */
+    LAT_WORK_EXEC,        /* workunit first checked out -> done, by its first finished copy */
+    NUM_LAT_METRICS
+};
+
+void latency_record(latency_metric metric, int site, int stage, double sec);
+Histogram* latency_get(latency_metric metric);
+Histogram* latency_get_stage(latency_metric metric, int stage);
+void latency_report();
+
+#endif	/* HISTOGRAM_H */
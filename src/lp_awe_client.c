@@ -1,8 +1,22 @@
+#include <math.h>
 #include "util.h"
 #include "awe_types.h"
+#include "profile.h"
+#include "checkpoint.h"
 #include "lp_awe_server.h"
 #include "lp_shock.h"
 #include "lp_shock_router.h"
+#include "lp_awe_client.h"
+#include "obj_cache.h"
+#include "transfer.h"
+#include "sampler.h"
+#include "histogram.h"
+#include "work_table.h"
+#include "straggler.h"
+#include "failure.h"
+#include "autoscale.h"
+#include "predict.h"
+#include "capability.h"
 
 #include <string.h>
 #include <assert.h>
@@ -19,15 +33,43 @@
 /* define state*/
 typedef struct awe_client_state awe_client_state;
 struct awe_client_state {
-    char current_work[MAX_LENGTH_ID];
+    int cur_work;         /* work idx of the copy being run, -1: idle */
+    int cur_attempt;      /* which copy of it, see WorkRun */
+    double cur_runtime;   /* in sec, compute left times the slowdown, plus checkpoints */
+    double cur_full;      /* in sec, whole compute of the workunit times the slowdown */
+    double cur_saved;     /* share of the compute restored from a workunit checkpoint */
+    int cur_ckpts;        /* workunit checkpoints written during cur_runtime */
+    tw_stime cur_compute_start;  /* -1 until the compute starts */
+    uint64_t cur_bytes;   /* transferred for the current copy */
+    tw_stime download_start_ts;
+    tw_stime upload_start_ts;
+    int site;             /* index of the client site */
+    int active;           /* takes part in the run, see get_client_scale() and autoscale.h */
+    int pool_idx;         /* index of the client within its site */
+    int cls;              /* client class, -1 without --client-file, see capability.h */
+    double speed;         /* the trace runtime is divided by this */
+    int req_pending;      /* a checkout request is waiting on the server */
+    ClientHealth *health; /* NULL if clients do not fail */
+    tw_lpid router_id;    /* shock_router serving the site */
+    tw_lpid server_id;    /* awe_server the site checks out work from */
     int  total_processed;
     double data_download_time; /*in sec*/
     double data_upload_time; /*in sec*/
     double compute_time;   /* in sec*/
     tw_stime start_ts;    /* time that we started sending requests */
-    tw_stime end_ts;      /* time that last request finished */
+    tw_stime end_ts;      /* time of the last activity (checkout, transfer or compute) */
+    ObjCache *predata_cache;  /* predata held locally, NULL if not cached */
+    tw_stime predata_start_ts;
+    double predata_download_time; /*in sec*/
+    uint64_t predata_size_downloaded;
+    uint64_t predata_size_saved;
 };
 
+/* client lp id -> predata cache, lets the server see what each client holds */
+static GHashTable *client_caches = NULL;
+
+static int clients_seen[MAX_NUM_SITES];  /* clients initialized so far per site */
+
 /* ROSS expects four functions per LP:
  * - an LP initialization function, called for each LP
  * - an event processing function
@@ -45,17 +87,24 @@ static void handle_work_checkout_event(awe_client_state * ns, tw_bf * b, awe_msg
 static void handle_compute_done_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 static void handle_input_downloaded_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 static void handle_output_uploaded_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_work_cancel_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_client_fail_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_client_recover_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_client_activate_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_client_deactivate_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 
 /*event planners*/
-static void plan_future_event(tw_lp *lp, awe_event_type event_type, tw_stime interval, void* userdata);
+static void plan_future_event(tw_lp *lp, awe_event_type event_type, tw_stime interval, Workunit* work, int attempt);
 
 /*msg senders*/
-static void send_work_checkout_request(tw_lp *lp, tw_stime offset);
-static void send_data_download_request(char* work_id, uint64_t size, tw_lp *lp);
-static void send_work_done_notification(char* work_id, tw_lp *lp);
+static void send_work_checkout_request(awe_client_state * ns, tw_lp *lp, tw_stime offset);
+static void send_data_download_request(awe_client_state * ns, Workunit* work, uint64_t size, int data_type, tw_lp *lp);
+static void send_work_done_notification(Workunit* work, int attempt, tw_lp *lp);
 
 /*data transfer*/
-static void upload_output_data(char* work_id, uint64_t size, tw_lp *lp);
+static void download_input_data(awe_client_state * ns, Workunit* work, tw_lp *lp);
+static void upload_output_data(awe_client_state * ns, Workunit* work, uint64_t size, tw_lp *lp);
+static uint64_t get_predata_miss_size(awe_client_state * ns, Workunit* work);
 
 /* set up the function pointers for ROSS, as well as the size of the LP state
  * structure (NOTE: ROSS is in charge of event and state (de-)allocation) */
@@ -97,6 +146,37 @@ void lpf_awe_client_init(
     tw_stime kickoff_time;
     
     memset(ns, 0, sizeof(*ns));
+    ns->cur_work = -1;
+    ns->site = get_site_id(lp->gid);
+    ns->router_id = get_site_router_lp_id(ns->site);
+    ns->server_id = get_site_server_lp_id(ns->site);
+    /* with a job sample only the same share of each site's clients runs,
+     * spread evenly over the site and at least one per site */
+    int idx = ns->site >= 0 ? clients_seen[ns->site]++ : 0;
+    double scale = get_client_scale();
+    ns->pool_idx = idx;
+    ns->cls = cap_enabled() ? cap_register_client(ns->site, idx, lp->gid) : -1;
+    ns->speed = cap_speed(ns->cls);
+    /* the sampled clients make up the pool, of which autoscaling starts the min */
+    if (ceil((idx + 1) * scale) > ceil(idx * scale)) {
+        ns->active = autoscale_register_client(ns->site, lp->gid, sim_offset);
+    }
+    if (ns->active) {
+        sampler_client_active(ns->site, 1);
+    }
+    if (ns->active && failure_enabled()) {
+        ns->health = failure_register_client(lp->gid);
+        failure_plan_client(ns->site, idx, lp);
+    }
+
+    if (client_predata_cache > 0) {
+        ns->predata_cache = obj_cache_new((uint64_t)client_predata_cache * Mega, CACHE_POLICY_LRU);
+        if (!client_caches) {
+            client_caches = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(client_caches, GSIZE_TO_POINTER(lp->gid), ns->predata_cache);
+        checkpoint_register_cache(lp->gid, ns->predata_cache);
+    }
             
     /* skew each kickoff event slightly to help avoid event ties later on */
     kickoff_time = g_tw_lookahead + tw_rand_unif(lp->rng); ;
@@ -122,6 +202,7 @@ void lpf_awe_client_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    tw_clock prof_start = prof_begin();
    switch (m->event_type)
     {
         case KICK_OFF:
@@ -139,10 +220,32 @@ void lpf_awe_client_event(
         case UPLOAD_ACK:
             handle_output_uploaded_event(ns, b, m, lp);
             break;
+        case WORK_CANCEL:
+            handle_work_cancel_event(ns, b, m, lp);
+            break;
+        case CLIENT_FAIL:
+            handle_client_fail_event(ns, b, m, lp);
+            break;
+        case CLIENT_RECOVER:
+            handle_client_recover_event(ns, b, m, lp);
+            break;
+        case CLIENT_ACTIVATE:
+            handle_client_activate_event(ns, b, m, lp);
+            break;
+        case CLIENT_DEACTIVATE:
+            handle_client_deactivate_event(ns, b, m, lp);
+            break;
+        case CHUNK_SENT:
+            transfer_chunk_sent(lp, m);
+            break;
         default:
 	    printf("\nawe_client Invalid message type %d from %lu\n", m->event_type, m->src);
         break;
     }
+    prof_end(PROF_AWE_CLIENT, m->event_type, prof_start);
+    if (m->event_type != KICK_OFF) {
+        ns->end_ts = tw_now(lp);
+    }
 }
 
 /* reverse event processing entry point
@@ -161,11 +264,14 @@ void lpf_awe_client_finalize(
     awe_client_state * ns,
     tw_lp * lp)
 {
-    ns->end_ts = tw_now(lp);
+    if (!ns->active && ns->total_processed == 0) {
+        return;
+    }
     double makespan = ns_to_s(ns->end_ts - ns->start_ts);
-    double compute_rate = ns->compute_time / makespan;
-    double download_rate = ns->data_download_time / makespan;
-    double upload_rate = ns->data_upload_time / makespan;
+    /* 0 for an active client that never got work */
+    double compute_rate = makespan > 0 ? ns->compute_time / makespan : 0;
+    double download_rate = makespan > 0 ? ns->data_download_time / makespan : 0;
+    double upload_rate = makespan > 0 ? ns->data_upload_time / makespan : 0;
     double total_busy_rate =compute_rate + download_rate + upload_rate;
 
     printf("[awe_client][%lu]start_time=%lf, end_time=%lf, makespan=%lf, processed=%d, compute_time=%lf, data_download_time=%lf, data_upload_time=%lf, total_busy_rate=%lf\n",
@@ -179,6 +285,15 @@ void lpf_awe_client_finalize(
             upload_rate,
             total_busy_rate
             );
+    if (ns->predata_size_downloaded > 0 || ns->predata_size_saved > 0) {
+        printf("[awe_client][%lu]predata_download_time=%lf, predata_size_downloaded=%llu, predata_size_saved=%llu, predata_hit_ratio=%lf\n",
+                lp->gid,
+                ns->predata_download_time,
+                (unsigned long long)ns->predata_size_downloaded,
+                (unsigned long long)ns->predata_size_saved,
+                ns->predata_cache ? obj_cache_hit_ratio(ns->predata_cache) : 0.0
+                );
+    }
     
     return;
 }
@@ -192,79 +307,297 @@ void handle_kick_off_event(
 {
     tw_stime offset = ns_tw_lookahead + s_to_ns(lp->gid / 1000);
 
-    send_work_checkout_request(lp, offset);
+    if (!ns->active || (ns->health && ns->health->down)) {  /* down at start: asks once repaired */
+        return;
+    }
+    send_work_checkout_request(ns, lp, offset);
     return;
 }
 
-/* workunit checkout -> download input from shock */
+/* workunit checkpoints written while computing sec, none at the very end */
+static int num_work_ckpts(double sec) {
+    if (work_ckpt_interval <= 0 || sec <= 0) {
+        return 0;
+    }
+    return (int)ceil(sec / work_ckpt_interval) - 1;
+}
+
+/* events of a copy that was cancelled meanwhile are dropped */
+static int is_current_copy(awe_client_state * ns, awe_msg * m) {
+    return m->obj_idx == ns->cur_work && m->attempt == ns->cur_attempt;
+}
+
+/* workunit checkout -> download missing predata, then input from shock */
 void handle_work_checkout_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    ns->req_pending = 0;
+    if (ns->health && ns->health->down) {
+        /* lost: the server took the lease at the current epoch, end it so that
+         * it is requeued even if the client recovers before the lease check */
+        if (strlen(m->object_id) > 0) {
+            ns->health->epoch += 1;
+        }
+        return;
+    }
     if (strlen(m->object_id)>0) {
         char* workid = m->object_id;
-        Workunit* work = g_hash_table_lookup(work_map, workid);
+        Workunit* work = get_work(m->obj_idx);
         fprintf(event_log, "%lf;awe_client;%lu;WC;workid=%s\n", now_sec(lp), lp->gid, workid);
-        send_data_download_request(workid, work->stats.size_infile, lp);
-        fprintf(event_log, "%lf;awe_client;%lu;FI;workid=%s filesize=%llu\n", now_sec(lp), lp->gid, workid, work->stats.size_infile);
-        work->stats.st_download_start = now_sec(lp);
+        ns->cur_work = m->obj_idx;
+        ns->cur_attempt = m->attempt;
+        ns->cur_compute_start = -1;
+        ns->cur_bytes = 0;
+        sampler_client_busy(ns->site, 1);
+        uint64_t predata_miss = get_predata_miss_size(ns, work);
+        if (predata_miss > 0) {
+            send_data_download_request(ns, work, predata_miss, DATA_PREDATA, lp);
+            fprintf(event_log, "%lf;awe_client;%lu;FP;workid=%s filesize=%llu\n", now_sec(lp), lp->gid, workid, (unsigned long long)predata_miss);
+            ns->predata_start_ts = tw_now(lp);
+            ns->predata_size_downloaded += predata_miss;
+        } else {
+            download_input_data(ns, work, lp);
+        }
     }
 }
+
+/* predata downloaded -> keep it locally and download input*/
+static void handle_predata_downloaded_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    char* workid = m->object_id;
+    Workunit* work = get_work(m->obj_idx);
+    double data_move_time_sec = ns_to_s(tw_now(lp) - ns->predata_start_ts);
+    if (ns->predata_cache) {
+        for (int i = 0; i < work->num_predata; i++) {
+            obj_cache_insert(ns->predata_cache, work->Predata[i].name, work->Predata[i].size);
+        }
+    }
+    fprintf(event_log, "%lf;awe_client;%lu;PD;workid=%s size_predata_in=%llu time_predata_in=%lf time_predata_in_sim=%lf\n",
+            now_sec(lp),
+            lp->gid,
+            workid,
+            (unsigned long long)m->size,
+            work_params.time_predata_in[work->idx],
+            data_move_time_sec);
+    ns->predata_download_time += data_move_time_sec;
+    download_input_data(ns, work, lp);
+}
+
 /* input downloaded -> start run command*/
 void handle_input_downloaded_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (!transfer_recv(lp, m)) {
+        return;
+    }
+    if (!is_current_copy(ns, m)) {
+        return;
+    }
+    if (m->data_type == DATA_PREDATA) {
+        handle_predata_downloaded_event(ns, b, m, lp);
+        return;
+    }
     if (strlen(m->object_id)>0) {
         char* workid = m->object_id;
-        Workunit* work = g_hash_table_lookup(work_map, workid);
-        work->stats.st_download_end = now_sec(lp);
+        int w = m->obj_idx;
+        Workunit* work = get_work(w);
+        work_runs[w].st_download_end = now_sec(lp);
 
-        double data_move_time_sec = work->stats.st_download_end - work->stats.st_download_start;
+        double data_move_time_sec = ns_to_s(tw_now(lp) - ns->download_start_ts);
 
         fprintf(event_log, "%lf;awe_client;%lu;FD;workid=%s size_data_in=%llu time_data_in=%lf time_data_in_sim=%lf\n",
         		now_sec(lp),
                 lp->gid, 
                 workid,
-                work->stats.size_infile,
-                work->stats.time_data_in,
+                (unsigned long long)work_params.size_infile[w],
+                work_params.time_data_in[w],
                 data_move_time_sec);
-        plan_future_event(lp, COMPUTE_DONE, s_to_ns(work->stats.runtime), workid);
+        ns->cur_full = work_params.runtime[w] / ns->speed * straggler_slowdown(ns->site, lp);
+        ns->cur_saved = work_runs[w].saved;
+        double remaining = ns->cur_full * (1 - ns->cur_saved);
+        ns->cur_ckpts = num_work_ckpts(remaining);
+        ns->cur_runtime = remaining + ns->cur_ckpts * work_ckpt_cost;
+        ns->cur_compute_start = tw_now(lp);
+        plan_future_event(lp, COMPUTE_DONE, s_to_ns(ns->cur_runtime), work, ns->cur_attempt);
         ns->data_download_time += data_move_time_sec;
+        latency_record(LAT_DOWNLOAD, ns->site, work->stage, data_move_time_sec);
         fprintf(event_log, "%lf;awe_client;%lu;WS;workid=%s\n", now_sec(lp), lp->gid, workid);
     }
 }
 
 /* compute done -> upload output to shock*/
 void handle_compute_done_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (!is_current_copy(ns, m)) {
+        return;
+    }
     char *workid = m->object_id;
-    Workunit* work = g_hash_table_lookup(work_map, workid);
-    fprintf(event_log, "%lf;awe_client;%lu;WD;workid=%s cmd=%s runtime=%lf\n", now_sec(lp), lp->gid, workid, work->cmd, work->stats.runtime);
-    upload_output_data(workid, work->stats.size_outfile, lp);
-    fprintf(event_log, "%lf;awe_client;%lu;FO;workid=%s filesize=%llu\n", now_sec(lp), lp->gid, workid, work->stats.size_outfile);
-    ns->compute_time += work->stats.runtime;
+    int w = m->obj_idx;
+    Workunit* work = get_work(w);
+    fprintf(event_log, "%lf;awe_client;%lu;WD;workid=%s cmd=%s runtime=%lf\n", now_sec(lp), lp->gid, workid, work->cmd, ns->cur_runtime);
+    upload_output_data(ns, work, work_params.size_outfile[w], lp);
+    fprintf(event_log, "%lf;awe_client;%lu;FO;workid=%s filesize=%llu\n", now_sec(lp), lp->gid, workid, (unsigned long long)work_params.size_outfile[w]);
+    ns->compute_time += ns->cur_runtime;
+    spec_stats.compute_time += ns->cur_runtime;
+    predict_observe(work, ns->cur_full * ns->speed, work_params.size_outfile[w]);  /* learned at speed 1 */
+    cap_record_run(ns->cls, ns->cur_runtime);
+    failure_stats.ckpt_overhead += ns->cur_ckpts * work_ckpt_cost;
 }
 
 /* output uploaded -> notify awe-server and ask for next workunit*/
 void handle_output_uploaded_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (!is_current_copy(ns, m)) {
+        return;
+    }
     ns->total_processed += 1;
     char *workid = m->object_id;
-    Workunit* work = g_hash_table_lookup(work_map, workid);
+    int w = m->obj_idx;
+    Workunit* work = get_work(w);
 
-    work->stats.st_upload_end = now_sec(lp);
+    work_runs[w].st_upload_end = now_sec(lp);
 
-    double data_move_time_sec = work->stats.st_upload_end - work->stats.st_upload_start;
+    double data_move_time_sec = ns_to_s(tw_now(lp) - ns->upload_start_ts);
 
     fprintf(event_log, "%lf;awe_client;%lu;FU;workid=%s size_data_out=%llu time_data_out=%lf time_data_out_sim=%lf\n",
     		    now_sec(lp),
                 lp->gid, 
                 workid,
-                work->stats.size_outfile,
-                work->stats.time_data_out,
-                work->stats.st_upload_end - work->stats.st_upload_start);
-    send_work_done_notification(workid, lp);
-    send_work_checkout_request(lp, g_tw_lookahead);
+                (unsigned long long)work_params.size_outfile[w],
+                work_params.time_data_out[w],
+                data_move_time_sec);
+    /* the other copy won, its cancel is on the way */
+    if (work_runs[w].state == WORK_DONE) {
+        spec_stats.compute_time -= ns->cur_runtime;
+        spec_stats.wasted_compute += ns->cur_runtime;
+        spec_stats.wasted_bytes += ns->cur_bytes;
+    }
+    send_work_done_notification(work, ns->cur_attempt, lp);
+    ns->cur_work = -1;
+    sampler_client_busy(ns->site, -1);
+    latency_record(LAT_UPLOAD, ns->site, work->stage, data_move_time_sec);
+    send_work_checkout_request(ns, lp, g_tw_lookahead);
     ns->data_upload_time += data_move_time_sec;
 }
 
-void send_work_checkout_request(tw_lp *lp, tw_stime offset) {
+/* the duplicate of this copy finished first: drop it and ask for other work.
+ * transfers in flight still complete, their bytes count as wasted */
+void handle_work_cancel_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (!is_current_copy(ns, m)) {
+        return;
+    }
+    double computed = 0;
+    if (ns->cur_compute_start >= 0) {
+        computed = ns_to_s(tw_now(lp) - ns->cur_compute_start);
+        if (computed > ns->cur_runtime) {
+            computed = ns->cur_runtime;
+            spec_stats.compute_time -= ns->cur_runtime;  /* counted when its compute finished */
+        }
+    }
+    fprintf(event_log, "%lf;awe_client;%lu;WX;workid=%s computed=%lf\n", now_sec(lp), lp->gid, m->object_id, computed);
+    spec_stats.num_cancelled += 1;
+    spec_stats.wasted_compute += computed;
+    spec_stats.wasted_bytes += ns->cur_bytes;
+    ns->cur_work = -1;
+    sampler_client_busy(ns->site, -1);
+    send_work_checkout_request(ns, lp, g_tw_lookahead);
+}
+
+/* the copy run dies with the client: keep what its checkpoints saved, count the rest as lost */
+static void lose_current_copy(awe_client_state * ns, tw_lp * lp) {
+    double lost = 0;
+    if (ns->cur_compute_start >= 0) {
+        double t = ns_to_s(tw_now(lp) - ns->cur_compute_start);
+        int done = t >= ns->cur_runtime;
+        if (done) {
+            t = ns->cur_runtime;
+        }
+        int k = work_ckpt_interval > 0 ? (int)(t / (work_ckpt_interval + work_ckpt_cost)) : 0;
+        if (k > ns->cur_ckpts) {
+            k = ns->cur_ckpts;
+        }
+        lost = t - k * (double)(work_ckpt_interval + work_ckpt_cost);
+        if (!done) {  /* counted at compute done otherwise */
+            failure_stats.ckpt_overhead += k * work_ckpt_cost;
+        }
+        WorkRun *run = &work_runs[ns->cur_work];
+        if (ns->cur_full > 0 && ns->cur_saved + k * work_ckpt_interval / ns->cur_full > run->saved) {
+            run->saved = ns->cur_saved + k * work_ckpt_interval / ns->cur_full;
+        }
+    }
+    fprintf(event_log, "%lf;awe_client;%lu;WL;workid=%s lost_compute=%lf\n", now_sec(lp), lp->gid, get_work(ns->cur_work)->id, lost);
+    failure_stats.lost_compute += lost;
+    ns->cur_work = -1;
+    sampler_client_busy(ns->site, -1);
+}
+
+/* the client goes down; failures overlapping one already in effect only extend it */
+void handle_client_fail_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (m->count && !sim_finished) {
+        tw_event *e = codes_event_new(lp->gid, s_to_ns(failure_time_to_repair(ns->site, lp)), lp);
+        awe_msg *msg = tw_event_data(e);
+        msg->event_type = CLIENT_RECOVER;
+        msg->src = lp->gid;
+        msg->count = 1;
+        tw_event_send(e);
+    }
+    if (ns->health->down++ > 0) {
+        return;
+    }
+    ns->health->epoch += 1;
+    ns->health->down_ts = tw_now(lp);
+    failure_stats.num_failures += 1;
+    fprintf(event_log, "%lf;awe_client;%lu;CF;site=%d\n", now_sec(lp), lp->gid, ns->site);
+    if (ns->cur_work >= 0) {
+        lose_current_copy(ns, lp);
+    }
+}
+
+void handle_client_recover_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (m->count && !sim_finished) {
+        tw_event *e = codes_event_new(lp->gid, s_to_ns(failure_time_to_fail(ns->site, lp)), lp);
+        awe_msg *msg = tw_event_data(e);
+        msg->event_type = CLIENT_FAIL;
+        msg->src = lp->gid;
+        msg->count = 1;
+        tw_event_send(e);
+    }
+    if (--ns->health->down > 0) {
+        return;
+    }
+    failure_stats.down_time += ns_to_s(tw_now(lp) - ns->health->down_ts);
+    fprintf(event_log, "%lf;awe_client;%lu;CR;site=%d\n", now_sec(lp), lp->gid, ns->site);
+    /* a request still queued on the server is answered as usual */
+    if (ns->active && !ns->req_pending) {
+        send_work_checkout_request(ns, lp, g_tw_lookahead);
+    }
+}
+
+/* provisioned by the autoscaler: start asking for work */
+void handle_client_activate_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    ns->active = 1;
+    sampler_client_active(ns->site, 1);
+    fprintf(event_log, "%lf;awe_client;%lu;CA;site=%d\n", now_sec(lp), lp->gid, ns->site);
+    if (failure_enabled() && !ns->health) {
+        ns->health = failure_register_client(lp->gid);
+        failure_plan_client(ns->site, ns->pool_idx, lp);
+    }
+    if (ns->start_ts == 0) {
+        ns->start_ts = tw_now(lp);
+    }
+    if (!ns->req_pending && !(ns->health && ns->health->down)) {
+        send_work_checkout_request(ns, lp, g_tw_lookahead);
+    }
+}
+
+/* released while idle, the server already dropped its checkout request */
+void handle_client_deactivate_event(awe_client_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    ns->active = 0;
+    ns->req_pending = 0;
+    sampler_client_active(ns->site, -1);
+    fprintf(event_log, "%lf;awe_client;%lu;CD;site=%d\n", now_sec(lp), lp->gid, ns->site);
+}
+
+void send_work_checkout_request(awe_client_state * ns, tw_lp *lp, tw_stime offset) {
     tw_event *e;
     awe_msg *msg;
-    tw_lpid server_id = get_awe_server_lp_id();
+    if (sim_finished) {
+        return;
+    }
+    tw_lpid server_id = ns->server_id;
     e = codes_event_new(server_id, offset, lp);
     msg = tw_event_data(e);
     msg->event_type = WORK_CHECKOUT;
@@ -273,67 +606,122 @@ void send_work_checkout_request(tw_lp *lp, tw_stime offset) {
     sprintf(str, "%lu", lp->gid);
     strcpy(msg->object_id, str);
     tw_event_send(e);
+    ns->req_pending = 1;
     return;
 }
 
-void send_work_done_notification(char* work_id, tw_lp *lp) {
+void send_work_done_notification(Workunit* work, int attempt, tw_lp *lp) {
     tw_event *e;
     awe_msg *msg;
-    tw_lpid server_id = get_awe_server_lp_id();
+    if (sim_finished) {  /* a duplicate finishing after the last job */
+        return;
+    }
+    tw_lpid server_id = get_job_server_lp_id(work->jobid);
     e = codes_event_new(server_id, ns_tw_lookahead, lp);
     msg = tw_event_data(e);
     msg->event_type = WORK_DONE;
     msg->src = lp->gid;
-    strcpy(msg->object_id, work_id);
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    msg->attempt = attempt;
     tw_event_send(e);
     return;
 }
 
-void send_data_download_request(char* work_id, uint64_t size, tw_lp *lp) {
+void send_data_download_request(awe_client_state * ns, Workunit* work, uint64_t size, int data_type, tw_lp *lp) {
     tw_event *e;
     awe_msg *msg;
-    tw_lpid dest_id = get_shock_router_lp_id();
+    tw_lpid dest_id = ns->router_id;
     e = codes_event_new(dest_id, ns_tw_lookahead, lp);
     msg = tw_event_data(e);
     msg->event_type = DNLOAD_REQ;
     msg->src = lp->gid;
     msg->next_hop = get_shock_lp_id();
     msg->size = size;
-    strcpy(msg->object_id, work_id);
+    msg->data_type = data_type;
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    msg->attempt = ns->cur_attempt;
+    ns->cur_bytes += size;
     tw_event_send(e);
     return;
 }
 
-void upload_output_data(char* work_id, uint64_t size, tw_lp *lp) {
+void download_input_data(awe_client_state * ns, Workunit* work, tw_lp *lp) {
+    send_data_download_request(ns, work, work_params.size_infile[work->idx], DATA_INPUT, lp);
+    fprintf(event_log, "%lf;awe_client;%lu;FI;workid=%s filesize=%llu\n", now_sec(lp), lp->gid, work->id, (unsigned long long)work_params.size_infile[work->idx]);
+    work_runs[work->idx].st_download_start = now_sec(lp);
+    ns->download_start_ts = tw_now(lp);
+}
+
+/* size of the predata the workunit needs but the client does not hold */
+uint64_t get_predata_miss_size(awe_client_state * ns, Workunit* work) {
+    uint64_t miss = 0;
+    for (int i = 0; i < work->num_predata; i++) {
+        DataObj *data = &work->Predata[i];
+        if (ns->predata_cache && obj_cache_lookup(ns->predata_cache, data->name, data->size)) {
+            ns->predata_size_saved += data->size;
+        } else {
+            miss += data->size;
+        }
+    }
+    return miss;
+}
+
+/* whether a client already holds all predata of a workunit */
+int client_holds_predata(tw_lpid client_id, Workunit* work) {
+    if (work->num_predata == 0) {
+        return 1;
+    }
+    if (!client_caches) {
+        return 0;
+    }
+    ObjCache *cache = g_hash_table_lookup(client_caches, GSIZE_TO_POINTER(client_id));
+    if (!cache) {
+        return 0;
+    }
+    for (int i = 0; i < work->num_predata; i++) {
+        if (!obj_cache_contains(cache, work->Predata[i].name)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void upload_output_data(awe_client_state * ns, Workunit* work, uint64_t size, tw_lp *lp) {
     awe_msg m_remote;
     /*awe_msg m_local;*/
     
-    tw_lpid dest_id = get_shock_router_lp_id();
+    tw_lpid dest_id = ns->router_id;
     
     m_remote.event_type = UPLOAD_REQ;
     m_remote.src = lp->gid;
     m_remote.next_hop = get_shock_lp_id();
-    strcpy(m_remote.object_id, work_id);
+    strcpy(m_remote.object_id, work->id);
+    m_remote.obj_idx = work->idx;
+    m_remote.attempt = ns->cur_attempt;
     m_remote.size =  size;
     
-    Workunit* work = g_hash_table_lookup(work_map, work_id);
-    work->stats.st_upload_start = now_sec(lp);
+    work_runs[work->idx].st_upload_start = now_sec(lp);
+    ns->upload_start_ts = tw_now(lp);
+    ns->cur_bytes += size;
 
-    model_net_event(net_id, "upload", dest_id, size, 0.0, sizeof(awe_msg),
-            (const void*)&m_remote, 0, NULL, lp);
+    transfer_send(lp, dest_id, &m_remote);
 
     return;
 }
 
-void plan_future_event(tw_lp *lp, awe_event_type event_type, tw_stime interval, void* userdata) {
+void plan_future_event(tw_lp *lp, awe_event_type event_type, tw_stime interval, Workunit* work, int attempt) {
     tw_event *e;
     awe_msg *msg;
     e = codes_event_new(lp->gid, interval, lp);
     msg = tw_event_data(e);
     msg->event_type = event_type;
     msg->src = lp->gid;
-    if (userdata) {
-        strcpy(msg->object_id, (char*)userdata);
+    if (work) {
+        strcpy(msg->object_id, work->id);
+        msg->obj_idx = work->idx;
+        msg->attempt = attempt;
     }
     /* event is ready to be processed, send it off */
     tw_event_send(e);
@@ -8,7 +8,16 @@
 #ifndef LP_AWE_CLIENT_H
 #define	LP_AWE_CLIENT_H
 
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+#define SCHED_PREDATA 3  /* sched_policy predata-aware: prefer clients already holding the predata */
+
 extern void register_lp_awe_client();
+extern int client_holds_predata(tw_lpid client_id, Workunit* work);
+
+extern int client_predata_cache; //predata cache capacity per client in MB, 0: no caching
 
 #endif	/* LP_AWE_CLIENT_H */
 
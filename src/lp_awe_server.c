@@ -4,8 +4,22 @@
 #include "glib.h"
 
 #include "lp_awe_server.h"
+#include "lp_awe_client.h"
 #include "util.h"
 #include "awe_types.h"
+#include "profile.h"
+#include "checkpoint.h"
+#include "sampler.h"
+#include "histogram.h"
+#include "arena.h"
+#include "work_table.h"
+#include "straggler.h"
+#include "failure.h"
+#include "autoscale.h"
+#include "fairshare.h"
+#include "critpath.h"
+#include "predict.h"
+#include "capability.h"
 
 #include "codes/codes.h"
 #include "codes/codes_mapping.h"
@@ -15,9 +29,16 @@
 GHashTable *work_map=NULL;
 GHashTable *job_map=NULL;
 
-static GQueue* work_queue;
-static GQueue* client_req_queue;
+static int num_servers = 0;
+static int num_jobs_done = 0;  /* over all servers */
+static double last_job_end = 0;  /* sim time in sec the last job finished */
 
+/* entries of the client request queues (tw_lpid), shared by all servers.
+ * work queues hold Workunit pointers and need no entries of their own */
+#define QUEUE_POOL_BLOCK 1024
+static Pool *clientid_pool = NULL;
+
+/* number of stages, then the stages in the order the greedy policy takes them */
 int WorkOrder[11] ={10, 5, 8, 4, 7, 9, 6, 3, 2, 0, 1};
 
 /* define state*/
@@ -26,11 +47,26 @@ typedef struct awe_server_state awe_server_state;
  * server in question. This struct is setup when the LP initialization function
  * ptr is called */
 struct awe_server_state {
+    int server_idx;       /* offset of this server, also the site it serves */
+    GQueue* work_queue;
+    FairShare* fs;        /* order of work_queue under fair-share, NULL otherwise */
+    CritPath* cp;         /* order of work_queue under critical-path, NULL otherwise */
+    Sjf* sjf;             /* order of work_queue under shortest-job-first, NULL otherwise */
+    int cap_queued[CAP_MAX_CLASSES]; /* queued workunits each client class can run, with --client-file */
+    GQueue* client_req_queue;
     int total_job;
     int total_task;
     int total_work;
+    int steal_pending;    /* a STEAL_REQ is outstanding */
+    int steal_victim;     /* offset of the peer asked last */
+    int steal_tries;      /* peers asked in the current steal round */
+    int steal_retry_armed;
+    int num_steal_req;    /* steal requests sent */
+    int num_stolen;       /* workunits taken from peers */
+    int num_given;        /* workunits handed to peers */
+    double last_scale_ts; /* in sim sec, of the last autoscaling step, -1: none yet */
     tw_stime start_ts;    /* time that we started sending requests */
-    tw_stime end_ts;      /* time that last request finished */
+    tw_stime end_ts;      /* time that the last workunit finished */
 };
 
 
@@ -51,16 +87,40 @@ static void handle_job_submit_event(awe_server_state * ns, tw_bf * b, awe_msg *
 static void handle_work_checkout_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 static void handle_work_enqueue_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 static void handle_work_done_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_steal_req_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_steal_ack_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_steal_retry_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_sample_tick_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_checkpoint_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_spec_check_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_lease_check_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
+static void handle_autoscale_tick_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp);
 
 /*event planner*/
-static void plan_work_enqueue_event(char* work_id, tw_lp *lp) ;
+static void plan_work_enqueue_event(Workunit* work, tw_lp *lp) ;
+static void plan_sample_tick_event(tw_lp *lp);
+static void plan_autoscale_tick_event(tw_lp *lp);
+static void plan_work_requeue_event(Workunit* work, int seq, tw_lp *lp);
+static void requeue_restored_work(awe_server_state * ns, tw_lp * lp);
+static void record_work_checkout(Workunit* work, tw_lpid client_id, tw_lp *lp);
+static void send_work_to_client(Workunit* work, tw_lpid client_id, tw_lp *lp);
+static void send_work_cancel(Workunit* work, tw_lpid client_id, int attempt, tw_lp *lp);
+static void plan_lease_check_event(Workunit* work, int attempt, tw_lp *lp);
 
 /*awe-server specific functions*/
 static void parse_ready_tasks(Job* job, tw_lp * lp);
-static char* get_first_work_by_stage(int stage);
-static char* get_first_work_by_greedy(int order[MAX_NUM_TASKS]);
-static int client_match_work(tw_lpid clientid, char* workid);
+static Workunit* get_first_work_by_class(GQueue* work_queue, int cls);
+static Workunit* get_first_work_by_stage(GQueue* work_queue, int stage, int cls);
+static Workunit* get_first_work_by_greedy(GQueue* work_queue, const int* order, int cls);
+static Workunit* get_first_work_by_predata(GQueue* work_queue, tw_lpid client_id, int cls);
+static Workunit* pick_work(awe_server_state * ns, tw_lpid client_id);
+static void queue_work(awe_server_state * ns, Workunit* work, int at_head);
+static void unqueue_work(awe_server_state * ns, GList* link);
+static int client_match_work(tw_lpid clientid, Workunit* work);
+static int site_match_work(int site, Workunit* work);
 static int get_group_id(tw_lpid client_id);
+static void try_steal_work(awe_server_state * ns, tw_lp * lp);
+static void send_steal_request(awe_server_state * ns, tw_lp * lp);
 
 
 /* set up the function pointers for ROSS, as well as the size of the LP state
@@ -118,15 +178,58 @@ static int jobmap_cleaning() {
 }
 
 void init_awe_server() {
+    /* already loaded, e.g. by the sweep runner before forking the runs: replay
+     * it from the start, unless it was loaded at a restart or warm start state */
+    if (job_map) {
+        if (!restart_file_name[0] && warm_start == 0) {
+            work_table_reset();
+        }
+        return;
+    }
     /*parse workload file and init job_map and work_map, make sure parse job_map first*/
+    double t0 = prof_wall_time();
     job_map = parse_jobtrace(jobtrace_file_name);
+    double t1 = prof_wall_time();
     work_map = parse_worktrace(worktrace_file_name);
+    double t2 = prof_wall_time();
     int ct = jobmap_cleaning(); 
+    prof_phase_add(PROF_PHASE_PARSE_JOBTRACE, t1 - t0);
+    prof_phase_add(PROF_PHASE_PARSE_WORKTRACE, t2 - t1);
+    prof_phase_add(PROF_PHASE_JOBMAP_CLEANING, prof_wall_time() - t2);
+    if (restart_file_name[0] || warm_start > 0) {
+        if (restart_file_name[0]) {
+            checkpoint_load(restart_file_name);
+        } else {
+            warm_start_from_trace(warm_start);
+        }
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, job_map);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            if (strcmp(((Job*)value)->state, "done") == 0) {
+                num_jobs_done += 1;
+            }
+        }
+    }
     printf("[awe_server]checking jobs...done, %d invalid jobs removed\n", ct);
     //display_hash_table(job_map, "job_map");
     printf("[awe_server]total valid jobs: %d\n", g_hash_table_size (job_map));
 }
 
+/* machine-readable workload outcome of the run, also collected by the sweep runner */
+void report_workload_summary() {
+    Histogram *turnaround = latency_get(LAT_JOB_TURNAROUND);
+    Histogram *work_wait = latency_get(LAT_WORK_WAIT);
+    printf("[awesim-result]jobs=%u,jobs_done=%d,makespan=%lf,turnaround_mean=%lf,turnaround_p95=%lf,work_wait_mean=%lf,work_wait_p95=%lf\n",
+        g_hash_table_size(job_map),
+        num_jobs_done,
+        last_job_end,
+        hist_mean(turnaround),
+        hist_percentile(turnaround, 0.95),
+        hist_mean(work_wait),
+        hist_percentile(work_wait, 0.95));
+}
+
 void register_lp_awe_server() {
     /* lp_type_register should be called exactly once per process per 
      * LP type */
@@ -139,6 +242,47 @@ tw_lpid get_awe_server_lp_id() {
     return rtn_id;
 }
 
+/* number of awe_server lps in the AWE_SERVER group, one per site when federated */
+static int get_num_awe_servers() {
+    if (num_servers == 0) {
+        for (int i = 0; i < lpconf.lpgroups_count; i++) {
+            if (strcmp(lpconf.lpgroups[i].name, "AWE_SERVER") != 0) {
+                continue;
+            }
+            for (int j = 0; j < lpconf.lpgroups[i].lptypes_count; j++) {
+                if (strcmp(lpconf.lpgroups[i].lptypes[j].name, "awe_server") == 0) {
+                    num_servers = lpconf.lpgroups[i].lptypes[j].count;
+                }
+            }
+        }
+        assert(num_servers > 0);
+    }
+    return num_servers;
+}
+
+static tw_lpid get_server_lp_id_by_offset(int offset) {
+    tw_lpid rtn_id;
+    codes_mapping_get_lp_id("AWE_SERVER", "awe_server", NULL, 1, 0, offset, &rtn_id);
+    return rtn_id;
+}
+
+/* server the clients of a site check out work from */
+tw_lpid get_site_server_lp_id(int site) {
+    if (site < 0) {
+        site = 0;
+    }
+    return get_server_lp_id_by_offset(site % get_num_awe_servers());
+}
+
+/* server owning a job: it submits the job and tracks its task progress */
+static int get_job_server_offset(char* job_id) {
+    return g_str_hash(job_id) % get_num_awe_servers();
+}
+
+tw_lpid get_job_server_lp_id(char* job_id) {
+    return get_server_lp_id_by_offset(get_job_server_offset(job_id));
+}
+
 void lpf_awe_server_init(
     awe_server_state * ns,
     tw_lp * lp)
@@ -148,8 +292,27 @@ void lpf_awe_server_init(
     tw_stime kickoff_time;
 
     memset(ns, 0, sizeof(*ns));
-    work_queue = g_queue_new();
-    client_req_queue = g_queue_new();
+    if (!clientid_pool) {
+        clientid_pool = pool_new(sizeof(tw_lpid), QUEUE_POOL_BLOCK);
+    }
+    ns->work_queue = g_queue_new();
+    if (sched_policy == SCHED_FAIRSHARE) {
+        ns->fs = fs_new();
+    } else if (sched_policy == SCHED_CRITPATH) {
+        ns->cp = cp_new();
+    } else if (sched_policy == SCHED_SJF) {
+        ns->sjf = sjf_new();
+    }
+    ns->client_req_queue = g_queue_new();
+    for (int i = 0; i < get_num_awe_servers(); i++) {
+        if (get_server_lp_id_by_offset(i) == lp->gid) {
+            ns->server_idx = i;
+        }
+    }
+    ns->steal_victim = ns->server_idx;
+    ns->last_scale_ts = -1;
+    sampler_register_server(ns->server_idx, ns->work_queue, ns->client_req_queue);
+    checkpoint_register_server(ns->server_idx, ns->work_queue);
     
     /* skew each kickoff event slightly to help avoid event ties later on */
     kickoff_time = 0;
@@ -175,6 +338,7 @@ void lpf_awe_server_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    tw_clock prof_start = prof_begin();
     switch (m->event_type)
     {
         case KICK_OFF:
@@ -187,15 +351,41 @@ void lpf_awe_server_event(
             handle_work_done_event(ns, b, m, lp);
             break;
         case WORK_ENQUEUE:
+        case WORK_REQUEUE:
             handle_work_enqueue_event(ns, b, m, lp);
             break;
+        case CHECKPOINT:
+            handle_checkpoint_event(ns, b, m, lp);
+            break;
         case WORK_CHECKOUT:
             handle_work_checkout_event(ns, b, m, lp);
             break;
+        case STEAL_REQ:
+            handle_steal_req_event(ns, b, m, lp);
+            break;
+        case STEAL_ACK:
+            handle_steal_ack_event(ns, b, m, lp);
+            break;
+        case STEAL_RETRY:
+            handle_steal_retry_event(ns, b, m, lp);
+            break;
+        case SAMPLE_TICK:
+            handle_sample_tick_event(ns, b, m, lp);
+            break;
+        case SPEC_CHECK:
+            handle_spec_check_event(ns, b, m, lp);
+            break;
+        case LEASE_CHECK:
+            handle_lease_check_event(ns, b, m, lp);
+            break;
+        case AUTOSCALE_TICK:
+            handle_autoscale_tick_event(ns, b, m, lp);
+            break;
         default:
             printf("\nawe_server Invalid message type %d from %lu\n", m->event_type, m->src);
         break;
     }
+    prof_end(PROF_AWE_SERVER, m->event_type, prof_start);
 }
 
 /* reverse event processing entry point
@@ -214,7 +404,6 @@ void lpf_awe_server_finalize(
     awe_server_state * ns,
     tw_lp * lp)
 {
-    ns->end_ts = tw_now(lp);
     printf("[awe_server][%lu]start_time=%lf;end_time=%lf, makespan=%lf, total_job=%d, total_task=%d, total_workunit=%d\n",
         lp->gid,
         ns->start_ts, 
@@ -223,6 +412,15 @@ void lpf_awe_server_finalize(
         ns->total_job,
         ns->total_task,
         ns->total_work);
+    if (get_num_awe_servers() > 1) {
+        printf("[awe_server][%lu]server_idx=%d, steal_requests=%d, workunits_stolen=%d, workunits_given=%d, queued_at_end=%u\n",
+            lp->gid,
+            ns->server_idx,
+            ns->num_steal_req,
+            ns->num_stolen,
+            ns->num_given,
+            g_queue_get_length(ns->work_queue));
+    }
     return;
 }
 
@@ -234,12 +432,33 @@ void handle_kick_off_event(
     tw_lp * lp)
 {
     printf("%lf;awe_server;%lu]Start serving\n", now_sec(lp), lp->gid);
+    /* the first server samples the state of all servers, clients and links */
+    if (sample_interval > 0 && ns->server_idx == 0) {
+        plan_sample_tick_event(lp);
+    }
+    if (autoscale_enabled()) {
+        plan_autoscale_tick_event(lp);
+    }
+    if (checkpoint_at > sim_offset && ns->server_idx == 0) {
+        tw_event *e = codes_event_new(lp->gid, s_to_ns(checkpoint_at - sim_offset), lp);
+        awe_msg *msg = tw_event_data(e);
+        msg->event_type = CHECKPOINT;
+        msg->src = lp->gid;
+        tw_event_send(e);
+    }
     GHashTableIter iter;
     gpointer key, value;
     g_hash_table_iter_init(&iter, job_map);
     
     while (g_hash_table_iter_next(&iter, &key, &value)) {
         Job* job = (Job*)value;
+        if (get_job_server_offset(job->id) != ns->server_idx) {
+            continue;
+        }
+        /* submitted before the checkpoint this run restarted from */
+        if (strcmp(job->state, "raw") != 0) {
+            continue;
+        }
         tw_event *e;
         awe_msg *msg;
         tw_stime submit_time;
@@ -247,15 +466,83 @@ void handle_kick_off_event(
         if (fraction < 1.0) {
         	submit_time = submit_time * fraction;
         }
+        submit_time -= s_to_ns(sim_offset);
+        if (submit_time < ns_tw_lookahead) {
+            submit_time = ns_tw_lookahead;
+        }
         e = codes_event_new(lp->gid, submit_time, lp);
         msg = tw_event_data(e);
         msg->event_type = JOB_SUBMIT;
         strcpy(msg->object_id, job->id);
+        msg->obj_idx = job->idx;
         tw_event_send(e);
     }
+    if (sim_offset > 0) {
+        requeue_restored_work(ns, lp);
+    }
     return;
 }
 
+/* after a restart or warm start: first the workunits of this server's jobs that were in
+ * flight at checkpoint time (checked out, or ready but not yet enqueued), then
+ * the workunits that were queued on this server, in their queue order */
+void requeue_restored_work(awe_server_state * ns, tw_lp * lp) {
+    int seq = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, job_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Job* job = (Job*)value;
+        if (get_job_server_offset(job->id) != ns->server_idx || strcmp(job->state, "submitted") != 0) {
+            continue;
+        }
+        for (int i = 0; i < job->num_tasks; i++) {
+            if (job->task_states[i] != 1) {
+                continue;
+            }
+            int first = job->task_splits[i] == 1 ? 0 : 1;
+            for (int r = first; r < first + job->task_splits[i]; r++) {
+                char work_id[MAX_LENGTH_ID];
+                sprintf(work_id, "%s_%d_%d", job->id, i, r);
+                Workunit* work = g_hash_table_lookup(work_map, work_id);
+                if (work_runs[work->idx].state == WORK_PENDING) {
+                    plan_work_requeue_event(work, seq++, lp);
+                }
+            }
+        }
+    }
+    GQueue* queue = checkpoint_take_queue(ns->server_idx);
+    if (queue) {
+        char* work_id;
+        while ((work_id = g_queue_pop_head(queue))) {
+            plan_work_requeue_event(g_hash_table_lookup(work_map, work_id), seq++, lp);
+            free(work_id);
+        }
+        g_queue_free(queue);
+    }
+    printf("[awe_server][%lu]%d workunits requeued after restart\n", lp->gid, seq);
+}
+
+/* seq spaces the events 1 ns apart to keep the queue order */
+void plan_work_requeue_event(Workunit* work, int seq, tw_lp *lp) {
+    tw_event *e;
+    awe_msg *msg;
+    e = codes_event_new(lp->gid, ns_tw_lookahead + seq, lp);
+    msg = tw_event_data(e);
+    msg->event_type = WORK_REQUEUE;
+    msg->src = lp->gid;
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    tw_event_send(e);
+}
+
+void handle_checkpoint_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    checkpoint_write(now_sec(lp));
+    if (checkpoint_stop) {
+        end_simulation(lp);
+    }
+}
+
 void handle_job_submit_event(
     awe_server_state * ns,
     tw_bf * b,
@@ -263,9 +550,10 @@ void handle_job_submit_event(
     tw_lp * lp)
 {
     char* job_id = m->object_id;
-    Job* job = g_hash_table_lookup(job_map, job_id);
-    assert(job);
-    fprintf(event_log, "%lf;awe_server;%lu;JQ;jobid=%s inputsize=%llu\n", now_sec(lp), lp->gid, job_id, job->inputsize);
+    Job* job = get_job(m->obj_idx);
+    fprintf(event_log, "%lf;awe_server;%lu;JQ;jobid=%s inputsize=%llu\n", now_sec(lp), lp->gid, job_id, (unsigned long long)job->inputsize);
+    strcpy(job->state, "submitted");
+    job->stats.start = now_sec(lp);
     parse_ready_tasks(job, lp);
     return;
 }
@@ -276,44 +564,46 @@ void handle_work_enqueue_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    Workunit* work = get_work(m->obj_idx);
+    /* a duplicate whose other copy finished meanwhile */
+    if (work_runs[work->idx].state == WORK_DONE) {
+        return;
+    }
     fprintf(event_log, "%lf;awe_server;%lu;WQ;work=%s\n", now_sec(lp), lp->gid, m->object_id);
+    if (m->event_type == WORK_ENQUEUE) {  /* stolen work keeps its original enqueue time */
+        work_runs[work->idx].st_created = now_sec(lp);
+    }
     
-    char* workid=NULL;
-    workid = malloc(sizeof(char[MAX_LENGTH_ID]));
-    strcpy(workid, m->object_id);
-    assert(workid);
     tw_lpid *clientid;
     int has_match = 0;
 
-    int len = g_queue_get_length(client_req_queue);
+    int len = g_queue_get_length(ns->client_req_queue);
     if (len > 0) {
     	int n = -1;
     	for (int i=0; i<len; i++) {
-    		clientid = g_queue_peek_nth(client_req_queue, i);
-    		if (client_match_work(*clientid, workid)) {
-    			 n = i;
-    			 break;
+    		clientid = g_queue_peek_nth(ns->client_req_queue, i);
+    		if (client_match_work(*clientid, work)) {
+    			if (n < 0) {
+    				n = i;
+    			}
+    			/* predata-aware: prefer a waiting client already holding the predata */
+    			if (sched_policy != SCHED_PREDATA || client_holds_predata(*clientid, work)) {
+    				n = i;
+    				break;
+    			}
     		}
     	}
     	if (n >=0) {
-    		clientid = g_queue_pop_nth(client_req_queue, n);
+    		clientid = g_queue_pop_nth(ns->client_req_queue, n);
     		has_match = 1;
     	}
     }
     
     if (has_match) {
-        tw_event *e;
-        awe_msg *msg;
-        e = codes_event_new(*clientid, ns_tw_lookahead, lp);
-        msg = tw_event_data(e);
-        msg->event_type = WORK_CHECKOUT;
-        strcpy(msg->object_id, workid);
-        tw_event_send(e);
-        fprintf(event_log, "%lf;awe_server;%lu;WC;work=%s client=%lu\n", now_sec(lp), lp->gid, workid, *clientid);
-        free(workid);
-        free(clientid);
+        send_work_to_client(work, *clientid, lp);
+        pool_free(clientid_pool, clientid);
     } else {
-    	g_queue_push_tail(work_queue, workid);
+        queue_work(ns, work, work_runs[work->idx].spec == 1);  /* duplicates go ahead of new work */
     }
     return;
 }
@@ -324,15 +614,6 @@ void handle_work_checkout_event(
     awe_msg * m,
     tw_lp * lp)
 {
-    tw_event *e;
-    awe_msg *msg;
-
-
-    e = codes_event_new(m->src, ns_tw_lookahead, lp);
-    msg = tw_event_data(e);
-    msg->event_type = WORK_CHECKOUT;
-    memset(msg->object_id, 0, sizeof(msg->object_id));
-    
     tw_lpid client_id = m->src;
 //    char group_name[MAX_LENGTH_GROUP];
     //char lp_type_name[MAX_LENGTH_GROUP];
@@ -340,44 +621,212 @@ void handle_work_checkout_event(
  //   codes_mapping_get_lp_info(client_id, group_name, &grp_id, &lp_type_id,
    //         lp_type_name, &grp_rep_id, &offset);
 
-    int group_id = 0;
-    group_id = get_group_id(client_id);
-
-    /*if queue is empty, msg->object_id is "", otherwise msg->object-id is the dequeued workid*/
-    int got_work = 0;
-    char workid[MAX_LENGTH_ID];
-    if (!g_queue_is_empty(work_queue)) {
-        if (group_id == 1 && sched_policy>0) {  //client from remote site
-            char* work = NULL;
-            if (sched_policy==1) {
-                work = get_first_work_by_stage(5); //checkout task 5 (blat) only for remote site
-            } else if (sched_policy==2) {
-            	work = get_first_work_by_greedy(WorkOrder);
-            }
-            if (work) {
-            	strcpy(workid, work);
-            	got_work = 1;
-            }
-        } else {
-        	strcpy(workid, g_queue_pop_head(work_queue));
-        	got_work = 1;
-        }
+    /* duplicates left queued after their other copy finished are dropped here */
+    Workunit* work;
+    while ((work = pick_work(ns, client_id)) && work_runs[work->idx].state == WORK_DONE) {
     }
 
-    if (got_work) { //eligible work found, send back to the requesting client
-        fprintf(event_log, "%lf;awe_server;%lu;WC;work=%s client=%lu\n", now_sec(lp), lp->gid, workid, m->src);
-        assert (strlen(workid) > 10);
-        strcpy(msg->object_id, workid);
-        tw_event_send(e);
+    if (work) { //eligible work found, send back to the requesting client
+        send_work_to_client(work, client_id, lp);
     } else {  //no eligible work found, put client request to the waiting queue
-        tw_lpid *clientid = NULL;
-        clientid = malloc(sizeof(tw_lpid));
+        tw_lpid *clientid = pool_alloc(clientid_pool);
         *clientid = m->src;
-        g_queue_push_tail(client_req_queue, clientid);
+        g_queue_push_tail(ns->client_req_queue, clientid);
+        try_steal_work(ns, lp);
     }
     return;
 }
 
+/* under fair-share, critical-path and shortest-job-first the user queues or the
+ * heap keep the order and work_queue, which the sampler, checkpoints and stealing look at,
+ * is kept in step through the links */
+void queue_work(awe_server_state * ns, Workunit* work, int at_head) {
+    if (at_head) {
+        g_queue_push_head(ns->work_queue, work);
+    } else {
+        g_queue_push_tail(ns->work_queue, work);
+    }
+    work_runs[work->idx].queue_link = at_head ? g_queue_peek_head_link(ns->work_queue) : g_queue_peek_tail_link(ns->work_queue);
+    if (cap_enabled()) {
+        cap_count_queued(ns->cap_queued, work, 1);
+    }
+    if (ns->fs) {
+        fs_push(ns->fs, work, at_head);
+    } else if (ns->cp) {
+        cp_push(ns->cp, work, at_head);
+    } else if (ns->sjf) {
+        sjf_push(ns->sjf, work, at_head);
+    }
+}
+
+void unqueue_work(awe_server_state * ns, GList* link) {
+    if (cap_enabled()) {
+        cap_count_queued(ns->cap_queued, (Workunit*)link->data, -1);
+    }
+    if (ns->fs) {
+        fs_remove(ns->fs, (Workunit*)link->data);
+    } else if (ns->cp) {
+        cp_remove(ns->cp, (Workunit*)link->data);
+    } else if (ns->sjf) {
+        sjf_remove(ns->sjf, (Workunit*)link->data);
+    }
+    g_queue_delete_link(ns->work_queue, link);
+}
+
+/* the eligible workunit the policy hands to the client, removed from the queue, NULL if none.
+ * With client classes every policy chooses among the workunits the client can run */
+Workunit* pick_work(awe_server_state * ns, tw_lpid client_id) {
+    int group_id = get_group_id(client_id);
+    int cls = cap_client_class(client_id);  //-1 without --client-file
+    if (g_queue_is_empty(ns->work_queue) || (cls >= 0 && ns->cap_queued[cls] == 0)) {
+        return NULL;
+    }
+    Workunit* work;
+    if (ns->fs || ns->cp || ns->sjf) {
+        work = ns->fs ? fs_pop(ns->fs, cls) : ns->cp ? cp_pop(ns->cp, cls) : sjf_pop(ns->sjf, cls);
+        assert(work);  /* the policy queues hold what work_queue holds */
+        g_queue_delete_link(ns->work_queue, work_runs[work->idx].queue_link);
+    } else if (group_id == 1 && (sched_policy==1 || sched_policy==2)) {  //client from remote site
+        if (sched_policy==1) {
+            work = get_first_work_by_stage(ns->work_queue, 5, cls); //checkout task 5 (blat) only for remote site
+        } else {
+            work = get_first_work_by_greedy(ns->work_queue, WorkOrder, cls);
+        }
+    } else if (sched_policy == SCHED_PREDATA) {
+        work = get_first_work_by_predata(ns->work_queue, client_id, cls);
+    } else if (group_id == 1 && sched_policy == SCHED_PREDICT_DATA) {
+        work = predict_pick_remote(ns->work_queue, cls);
+    } else {
+        work = get_first_work_by_class(ns->work_queue, cls);
+    }
+    if (work && cap_enabled()) {
+        cap_count_queued(ns->cap_queued, work, -1);
+    }
+    return work;
+}
+
+/* hand a copy of the workunit to the client. The first copy is checked out and
+ * watched for straggling, a second one is the duplicate dispatched by SPEC_CHECK */
+void send_work_to_client(Workunit* work, tw_lpid client_id, tw_lp *lp) {
+    WorkRun *run = &work_runs[work->idx];
+    int attempt = run->attempts++;
+    if (run->spec == 1) {
+        run->spec = 2;
+        run->spec_attempt = attempt;
+        run->spec_client = client_id;
+        run->spec_epoch = failure_client_epoch(client_id);
+    } else {
+        run->attempt = attempt;
+        run->client = client_id;
+        run->client_epoch = failure_client_epoch(client_id);
+        if (run->promoted) {  /* the wait and the usage estimate were taken at the lost checkout */
+            run->promoted = 0;
+            run->st_checkout = now_sec(lp);
+        } else {
+            fs_work_started(work, now_sec(lp));
+            record_work_checkout(work, client_id, lp);
+        }
+        double threshold = spec_threshold(work->stage);
+        if (threshold >= 0) {
+            tw_event *e = codes_event_new(lp->gid, s_to_ns(threshold), lp);
+            awe_msg *msg = tw_event_data(e);
+            msg->event_type = SPEC_CHECK;
+            msg->src = lp->gid;
+            strcpy(msg->object_id, work->id);
+            msg->obj_idx = work->idx;
+            msg->attempt = attempt;
+            tw_event_send(e);
+        }
+    }
+    tw_event *e;
+    awe_msg *msg;
+    e = codes_event_new(client_id, ns_tw_lookahead, lp);
+    msg = tw_event_data(e);
+    msg->event_type = WORK_CHECKOUT;
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    msg->attempt = attempt;
+    tw_event_send(e);
+    fprintf(event_log, "%lf;awe_server;%lu;WC;work=%s client=%lu attempt=%d\n", now_sec(lp), lp->gid, work->id, client_id, attempt);
+    if (lease_timeout > 0) {
+        plan_lease_check_event(work, attempt, lp);
+    }
+}
+
+void plan_lease_check_event(Workunit* work, int attempt, tw_lp *lp) {
+    if (sim_finished) {
+        return;
+    }
+    tw_event *e = codes_event_new(lp->gid, s_to_ns(lease_timeout), lp);
+    awe_msg *msg = tw_event_data(e);
+    msg->event_type = LEASE_CHECK;
+    msg->src = lp->gid;
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    msg->attempt = attempt;
+    tw_event_send(e);
+}
+
+/* lease of a copy expired: renewed while its client stays up, otherwise the
+ * copy is lost and the workunit goes back to the queue, unless its other copy
+ * still runs or waits there */
+void handle_lease_check_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    Workunit* work = get_work(m->obj_idx);
+    WorkRun *run = &work_runs[work->idx];
+    int is_first = m->attempt == run->attempt;
+    int is_spec = run->spec == 2 && m->attempt == run->spec_attempt;
+    if (run->state == WORK_DONE || (!is_first && !is_spec)) {
+        return;
+    }
+    tw_lpid client_id = is_first ? run->client : run->spec_client;
+    if (failure_lease_valid(client_id, is_first ? run->client_epoch : run->spec_epoch)) {
+        plan_lease_check_event(work, m->attempt, lp);
+        return;
+    }
+    failure_stats.num_requeued += 1;
+    fprintf(event_log, "%lf;awe_server;%lu;LX;work=%s client=%lu attempt=%d\n", now_sec(lp), lp->gid, work->id, client_id, m->attempt);
+    if (is_spec) {
+        run->spec = 0;
+    } else if (run->spec == 2) {  /* the duplicate carries on as the first copy */
+        run->attempt = run->spec_attempt;
+        run->client = run->spec_client;
+        run->client_epoch = run->spec_epoch;
+        run->spec = 0;
+    } else if (run->spec == 1) {  /* the queued duplicate becomes the first copy */
+        run->spec = 0;
+        run->promoted = 1;
+        run->st_created = now_sec(lp);
+    } else {
+        run->st_created = now_sec(lp);
+        plan_work_requeue_event(work, 0, lp);
+    }
+}
+
+/* the copy checked out at the threshold is still running: queue a duplicate */
+void handle_spec_check_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    WorkRun *run = &work_runs[m->obj_idx];
+    if (run->state == WORK_DONE || run->spec != 0 || run->attempt != m->attempt) {
+        return;
+    }
+    run->spec = 1;
+    spec_stats.num_duplicates += 1;
+    fprintf(event_log, "%lf;awe_server;%lu;DQ;work=%s client=%lu\n", now_sec(lp), lp->gid, m->object_id, run->client);
+    plan_work_requeue_event(get_work(m->obj_idx), 0, lp);
+}
+
+void send_work_cancel(Workunit* work, tw_lpid client_id, int attempt, tw_lp *lp) {
+    tw_event *e;
+    awe_msg *msg;
+    e = codes_event_new(client_id, ns_tw_lookahead, lp);
+    msg = tw_event_data(e);
+    msg->event_type = WORK_CANCEL;
+    msg->src = lp->gid;
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
+    msg->attempt = attempt;
+    tw_event_send(e);
+}
+
 void handle_work_done_event(awe_server_state * ns,
         tw_bf * b,
         awe_msg * m,
@@ -385,13 +834,31 @@ void handle_work_done_event(awe_server_state * ns,
 {
     char *work_id = m->object_id;
     
-    gchar ** parts = g_strsplit(work_id, "_", 3);
-    char* job_id = parts[0];
-    int task_id = atoi(parts[1]);
-    Job* job = g_hash_table_lookup(job_map, job_id);
+    Workunit* work = get_work(m->obj_idx);
+    char* job_id = work->jobid;
+    int task_id = work->stage;
+    Job* job = get_job(work->job_idx);
+    WorkRun *run = &work_runs[work->idx];
+    /* the other copy finished first */
+    if (run->state == WORK_DONE) {
+        spec_stats.num_late += 1;
+        return;
+    }
+    run->state = WORK_DONE;
+    if (run->spec == 2) {
+        if (m->attempt == run->spec_attempt) {
+            spec_stats.num_won += 1;
+            send_work_cancel(work, run->client, run->attempt, lp);
+        } else {
+            send_work_cancel(work, run->spec_client, run->spec_attempt, lp);
+        }
+    }
+    latency_record(LAT_WORK_EXEC, get_group_id(m->src), task_id, now_sec(lp) - run->st_checkout);
+    fs_work_done(work, now_sec(lp) - run->st_checkout, now_sec(lp));
     job->task_remainwork[task_id] -= 1;
     fprintf(event_log, "%lf;awe_server;%lu;WD;workid=%s\n", now_sec(lp), lp->gid, work_id);
     ns->total_work += 1;
+    ns->end_ts = tw_now(lp);
     /*handle task done*/
     if (job->task_remainwork[task_id] == 0) { 
     	 fprintf(event_log, "%lf;awe_server;%lu;TD;taskid=%s_%d\n", now_sec(lp), lp->gid, job_id, task_id);
@@ -405,7 +872,18 @@ void handle_work_done_event(awe_server_state * ns,
          /*handle job done*/
         if (job->remain_tasks==0) {
              fprintf(event_log, "%lf;awe_server;%lu;JD;jobid=%s\n", now_sec(lp), lp->gid, job_id);
+             job->stats.end = now_sec(lp);
+             strcpy(job->state, "done");
+             latency_record(LAT_JOB_TURNAROUND, -1, -1, job->stats.end - job->stats.start);
+             fs_job_done(job, job->stats.end - job->stats.start);
              ns->total_job += 1;
+             num_jobs_done += 1;
+             last_job_end = now_sec(lp);
+             if (num_jobs_done == (int)g_hash_table_size(job_map)) {
+                 printf("[awe_server][%lu]all %d jobs done at %lf, ending simulation\n", lp->gid, num_jobs_done, now_sec(lp));
+                 autoscale_close(now_sec(lp));
+                 end_simulation(lp);
+             }
         }
     }
 }
@@ -422,56 +900,153 @@ void parse_ready_tasks(Job* job, tw_lp * lp) {
         if (is_ready && job->task_states[i]==0) {
             fprintf(event_log, "%lf;awe_server;%lu;TQ;taskid=%s_%d splits=%d\n", now_sec(lp), lp->gid, job->id, i, job->task_splits[i]);
             job->task_states[i]=1;
+            job->task_stats[i].created = now_sec(lp);
+            job->task_stats[i].start = -1;
             if (job->task_splits[i] == 1) {
                 char work_id[MAX_LENGTH_ID];
                 sprintf(work_id, "%s_%d_0", job->id, i);
-                plan_work_enqueue_event(work_id, lp);
+                plan_work_enqueue_event(g_hash_table_lookup(work_map, work_id), lp);
             } else if (job->task_splits[i] > 1) {
                 for (int j=1; j<=job->task_splits[i]; j++) {
                     char work_id[MAX_LENGTH_ID];
                     sprintf(work_id, "%s_%d_%d", job->id, i, j);
-                    plan_work_enqueue_event(work_id, lp);
+                    plan_work_enqueue_event(g_hash_table_lookup(work_map, work_id), lp);
                 }
             }
         }
     }
 }
 
-void plan_work_enqueue_event(char* work_id, tw_lp *lp) {
+void plan_work_enqueue_event(Workunit* work, tw_lp *lp) {
     tw_event *e;
     awe_msg *msg;
     e = codes_event_new(lp->gid, ns_tw_lookahead, lp);
     msg = tw_event_data(e);
     msg->event_type = WORK_ENQUEUE;
-    strcpy(msg->object_id, work_id);
+    strcpy(msg->object_id, work->id);
+    msg->obj_idx = work->idx;
     tw_event_send(e);
 }
 
-char* get_first_work_by_stage(int stage) {
-	char *workid = NULL;
-	int len = g_queue_get_length(work_queue);
-    int n = -1;
-	for (int i=0; i<len; i++) {
-	    workid = g_queue_peek_nth(work_queue, i);
-        gchar **seg = g_strsplit(workid, "_", 3);
-        int taskid = atoi(seg[1]);
-        if (taskid == stage) {
-        	n = i;
-        	break;
+/* workunit handed to a client: record its queue wait and that of its task */
+void record_work_checkout(Workunit* work, tw_lpid client_id, tw_lp *lp) {
+    Job* job = get_job(work->job_idx);
+    int site = get_group_id(client_id);
+    work_runs[work->idx].st_checkout = now_sec(lp);
+    latency_record(LAT_WORK_WAIT, site, work->stage, work_runs[work->idx].st_checkout - work_runs[work->idx].st_created);
+    TaskStat *task = &job->task_stats[work->stage];
+    if (task->start < 0) {
+        task->start = now_sec(lp);
+        latency_record(LAT_TASK_QUEUE_WAIT, site, work->stage, task->start - task->created);
+    }
+}
+
+void plan_sample_tick_event(tw_lp *lp) {
+    tw_event *e;
+    awe_msg *msg;
+    e = codes_event_new(lp->gid, s_to_ns(sample_interval), lp);
+    msg = tw_event_data(e);
+    msg->event_type = SAMPLE_TICK;
+    msg->src = lp->gid;
+    tw_event_send(e);
+}
+
+void handle_sample_tick_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    sampler_write_sample(now_sec(lp));
+    if (!sim_finished) {
+        plan_sample_tick_event(lp);
+    }
+}
+
+void plan_autoscale_tick_event(tw_lp *lp) {
+    tw_event *e = codes_event_new(lp->gid, s_to_ns(scale_interval), lp);
+    awe_msg *msg = tw_event_data(e);
+    msg->event_type = AUTOSCALE_TICK;
+    msg->src = lp->gid;
+    tw_event_send(e);
+}
+
+/* size the client pools of the sites checking out from this server, see autoscale.h */
+void handle_autoscale_tick_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (!sim_finished) {
+        plan_autoscale_tick_event(lp);
+    }
+    if (ns->last_scale_ts >= 0 && now_sec(lp) - ns->last_scale_ts < scale_cooldown) {
+        return;
+    }
+    int num_sites = get_num_sites();
+    int active = 0;
+    for (int s = ns->server_idx; s < num_sites; s += get_num_awe_servers()) {
+        active += autoscale_num_active(s);
+    }
+    /* clients in provisioning count as busy, they take on the queue once up */
+    int idle = g_queue_get_length(ns->client_req_queue);
+    int queued = g_queue_get_length(ns->work_queue);
+    int desired = active - idle + (queued + scale_queue_per_client - 1) / scale_queue_per_client;
+    if (queued > 0 && scale_up_wait > 0 && desired <= active) {
+        Workunit* head = g_queue_peek_head(ns->work_queue);
+        if (now_sec(lp) - work_runs[head->idx].st_created > scale_up_wait) {
+            desired = active + 1;
+        }
+    }
+    int before = active;
+    if (desired > active) {
+        for (int s = ns->server_idx; s < num_sites && active < desired; s += get_num_awe_servers()) {
+            while (active < desired && autoscale_activate(s, lp)) {
+                active++;
+            }
+        }
+    } else if (desired < active) {
+        int last = ns->server_idx + (num_sites - 1 - ns->server_idx) / get_num_awe_servers() * get_num_awe_servers();
+        for (int s = last; s >= 0 && active > desired; s -= get_num_awe_servers()) {
+            GList* link = g_queue_peek_tail_link(ns->client_req_queue);
+            while (link && active > desired && autoscale_num_active(s) > autoscale_min(s)) {
+                GList* prev = link->prev;
+                tw_lpid *clientid = link->data;
+                if (get_site_id(*clientid) == s) {
+                    autoscale_deactivate(s, *clientid, lp);
+                    g_queue_delete_link(ns->client_req_queue, link);
+                    pool_free(clientid_pool, clientid);
+                    active--;
+                }
+                link = prev;
+            }
+        }
+    }
+    if (active != before) {
+        ns->last_scale_ts = now_sec(lp);
+        fprintf(event_log, "%lf;awe_server;%lu;AS;queued=%d idle=%d desired=%d clients=%d->%d\n", now_sec(lp), lp->gid, queued, idle, desired, before, active);
+    }
+}
+
+/* cls: class of the client, -1: any */
+Workunit* get_first_work_by_class(GQueue* work_queue, int cls) {
+	for (GList* link = g_queue_peek_head_link(work_queue); link; link = link->next) {
+	    Workunit* work = (Workunit*)link->data;
+        if (cap_class_match(cls, work)) {
+        	g_queue_delete_link(work_queue, link);
+        	return work;
         }
 	}
-	if (n >= 0) {
-		return g_queue_pop_nth(work_queue, n);
+	return NULL;
+}
+Workunit* get_first_work_by_stage(GQueue* work_queue, int stage, int cls) {
+	for (GList* link = g_queue_peek_head_link(work_queue); link; link = link->next) {
+	    Workunit* work = (Workunit*)link->data;
+        if (work->stage == stage && cap_class_match(cls, work)) {
+        	g_queue_delete_link(work_queue, link);
+        	return work;
+        }
 	}
 	return NULL;
 }
 
-char* get_first_work_by_greedy(int order[MAX_NUM_TASKS]) {
-	int num_task = order[MAX_NUM_TASKS];
+Workunit* get_first_work_by_greedy(GQueue* work_queue, const int* order, int cls) {
+	int num_task = order[0];
 	assert (num_task > 0);
-	char* work = NULL;
-	for (int i=0; i<num_task; i++) {
-        work = get_first_work_by_stage(order[i]); //checkout task 5 (blat) only for remote site
+	Workunit* work = NULL;
+	for (int i=1; i<=num_task; i++) {
+        work = get_first_work_by_stage(work_queue, order[i], cls); //checkout task 5 (blat) only for remote site
         if (work) {
         	break;
         }
@@ -479,29 +1054,163 @@ char* get_first_work_by_greedy(int order[MAX_NUM_TASKS]) {
 	return work;
 }
 
-int client_match_work(tw_lpid client_id, char* workid) {
-    int match = 1;
+/* first queued workunit whose predata the client already holds, queue head otherwise */
+Workunit* get_first_work_by_predata(GQueue* work_queue, tw_lpid client_id, int cls) {
+	for (GList* link = g_queue_peek_head_link(work_queue); link; link = link->next) {
+		Workunit* work = (Workunit*)link->data;
+		if (work->num_predata > 0 && client_holds_predata(client_id, work) && cap_class_match(cls, work)) {
+			g_queue_delete_link(work_queue, link);
+			return work;
+		}
+	}
+	return get_first_work_by_class(work_queue, cls);
+}
+
+int client_match_work(tw_lpid client_id, Workunit* work) {
     //char group_name[MAX_LENGTH_GROUP];
     //char lp_type_name[MAX_LENGTH_GROUP];
     //codes_mapping_get_lp_info(clientid, group_name, grp_id, lp_type_id, lp_type_name, grp_rep_id, offset);
 
+    if (cap_enabled()) {
+        return cap_class_match(cap_client_class(client_id), work);
+    }
     int group_id = 0;
     group_id = get_group_id(client_id);
+    return site_match_work(group_id, work);
+}
+
+int site_match_work(int group_id, Workunit* work) {
+    if (cap_enabled()) {
+        return cap_site_match(group_id, work);
+    }
+    int match = 1;
     if (group_id == 1) {  //remote client
-    	gchar **seg = g_strsplit(workid, "_", 3);
-    	int taskid = atoi(seg[1]);
-    	if (taskid != 5) {
+    	if (work->stage != 5) {
     		match = 0;
     	}
     }
     return match;
 }
 
-int get_group_id(tw_lpid client_id) {
-    if (client_id < 55) {  //TO-DO, make the pivot configurable, or use code_mapping_get_lp_info directly in the future
-    	return 0;
-    } else {
-        return 1;
+/* offset of a server lp in the AWE_SERVER group */
+static int get_server_offset(tw_lpid server_id) {
+    for (int i = 0; i < get_num_awe_servers(); i++) {
+        if (get_server_lp_id_by_offset(i) == server_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* a server whose clients sit idle with nothing queued asks its peers for work */
+void try_steal_work(awe_server_state * ns, tw_lp * lp) {
+    if (steal_batch <= 0 || get_num_awe_servers() < 2 || ns->steal_pending || sim_finished) {
+        return;
     }
+    if ((int)g_queue_get_length(ns->client_req_queue) < steal_min_idle || !g_queue_is_empty(ns->work_queue)) {
+        return;
+    }
+    ns->steal_pending = 1;
+    ns->steal_tries = 0;
+    send_steal_request(ns, lp);
+}
+
+/* ask the next peer in round-robin order, the request takes the fixed WAN latency */
+void send_steal_request(awe_server_state * ns, tw_lp * lp) {
+    tw_event *e;
+    awe_msg *msg;
+    ns->steal_victim = (ns->steal_victim + 1) % get_num_awe_servers();
+    if (ns->steal_victim == ns->server_idx) {
+        ns->steal_victim = (ns->steal_victim + 1) % get_num_awe_servers();
+    }
+    ns->steal_tries += 1;
+    ns->num_steal_req += 1;
+    e = codes_event_new(get_server_lp_id_by_offset(ns->steal_victim), s_to_ns(steal_latency / 1000.0) + ns_tw_lookahead, lp);
+    msg = tw_event_data(e);
+    msg->event_type = STEAL_REQ;
+    msg->src = lp->gid;
+    msg->count = steal_batch;
+    memset(msg->object_id, 0, sizeof(msg->object_id));
+    tw_event_send(e);
+    fprintf(event_log, "%lf;awe_server;%lu;SR;victim=%d idle_clients=%u\n", now_sec(lp), lp->gid, ns->steal_victim, g_queue_get_length(ns->client_req_queue));
+}
+
+/* work is NULL if the victim has none to give */
+static void send_steal_ack(Workunit* work, tw_lpid thief_id, tw_lp * lp) {
+    tw_event *e;
+    awe_msg *msg;
+    e = codes_event_new(thief_id, s_to_ns(steal_latency / 1000.0) + ns_tw_lookahead, lp);
+    msg = tw_event_data(e);
+    msg->event_type = STEAL_ACK;
+    msg->src = lp->gid;
+    strcpy(msg->object_id, work ? work->id : "");
+    msg->obj_idx = work ? work->idx : -1;
+    tw_event_send(e);
+}
+
+/* victim side: hand over up to m->count eligible workunits from the queue tail */
+void handle_steal_req_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (sim_finished) {
+        return;
+    }
+    int thief_site = get_server_offset(m->src);
+    int given = 0;
+    GList* link = g_queue_peek_tail_link(ns->work_queue);
+    while (link && given < m->count && (int)g_queue_get_length(ns->work_queue) > steal_min_queue) {
+        GList* prev = link->prev;
+        Workunit* work = (Workunit*)link->data;
+        if (work_runs[work->idx].state == WORK_DONE) {  /* stale duplicate */
+            unqueue_work(ns, link);
+        } else if (site_match_work(thief_site, work)) {
+            send_steal_ack(work, m->src, lp);
+            unqueue_work(ns, link);
+            given += 1;
+        }
+        link = prev;
+    }
+    if (given == 0) {
+        send_steal_ack(NULL, m->src, lp);
+    }
+    ns->num_given += given;
+    fprintf(event_log, "%lf;awe_server;%lu;SG;thief=%d count=%d\n", now_sec(lp), lp->gid, thief_site, given);
+}
+
+/* thief side: queue a stolen workunit, or move on to the next peer */
+void handle_steal_ack_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    if (strlen(m->object_id) > 0) {
+        ns->steal_pending = 0;
+        ns->num_stolen += 1;
+        handle_work_enqueue_event(ns, b, m, lp);
+        return;
+    }
+    if (!ns->steal_pending) {
+        return;
+    }
+    if (ns->steal_tries < get_num_awe_servers() - 1) {
+        send_steal_request(ns, lp);
+        return;
+    }
+    /* no peer had eligible work, try again later while jobs remain */
+    ns->steal_pending = 0;
+    if (steal_retry > 0 && !ns->steal_retry_armed && !sim_finished) {
+        tw_event *e;
+        awe_msg *msg;
+        e = codes_event_new(lp->gid, s_to_ns(steal_retry), lp);
+        msg = tw_event_data(e);
+        msg->event_type = STEAL_RETRY;
+        msg->src = lp->gid;
+        tw_event_send(e);
+        ns->steal_retry_armed = 1;
+    }
+}
+
+void handle_steal_retry_event(awe_server_state * ns, tw_bf * b, awe_msg * m, tw_lp * lp) {
+    ns->steal_retry_armed = 0;
+    try_steal_work(ns, lp);
+}
+
+/* site index of a client: 0 for the first AWE_CLIENT_SITE_* group (local), 1 for the second (remote), ... */
+int get_group_id(tw_lpid client_id) {
+    return get_site_id(client_id);
 }
 
@@ -13,10 +13,23 @@
 
 
 extern void init_awe_server();
+extern void report_workload_summary();
 extern void register_lp_awe_server();
 extern tw_lpid get_awe_server_lp_id();
+extern tw_lpid get_site_server_lp_id(int site);
+extern tw_lpid get_job_server_lp_id(char* job_id);
 
-extern int sched_policy; //0: round-robin, 1: data-aware-best-fit, 2: data-aware-greedy
+extern int sched_policy; //0: round-robin, 1: data-aware-best-fit, 2: data-aware-greedy, 3: predata-aware, 4: fair-share, 5: critical-path, 6: shortest-job-first, 7: predicted data-aware
+
+/* work stealing between per-site servers. Like every other awe_server message,
+ * steal requests and acks are plain events rather than model-net traffic: the
+ * AWE_SERVER group has no simplewan LP, so they take a fixed steal_latency and
+ * neither use the bandwidth and startup matrices nor contend for the links */
+extern int steal_batch; //max workunits taken per steal, 0: stealing disabled
+extern int steal_min_idle; //idle clients needed before a server steals
+extern int steal_min_queue; //workunits a victim always keeps for itself
+extern int steal_latency; //one-way server-to-server WAN latency in ms
+extern int steal_retry; //seconds between steal attempts while clients stay idle
 
 #endif	/* LP_AWE_SVR_H */
 
@@ -6,6 +6,8 @@
 #include "lp_shock.h"
 #include "util.h"
 #include "awe_types.h"
+#include "profile.h"
+#include "transfer.h"
 
 #include "codes/model-net.h"
 #include "codes/codes.h"
@@ -25,7 +27,7 @@ struct shock_state {
     double time_download;
     double time_upload;
     tw_stime start_ts;    /* time that we started sending requests */
-    tw_stime end_ts;      /* time that last request finished */
+    tw_stime end_ts;      /* time of the last data transfer activity */
 };
 
 
@@ -108,6 +110,7 @@ void lpf_shock_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    tw_clock prof_start = prof_begin();
     switch (m->event_type)
     {
         case KICK_OFF:
@@ -119,10 +122,17 @@ void lpf_shock_event(
         case UPLOAD_REQ:
             handle_data_upload_event(ns, b, m, lp);
             break;
+        case CHUNK_SENT:
+            transfer_chunk_sent(lp, m);
+            break;
         default:
 	    printf("\n Shock Invalid message type %d \n", m->event_type);
         break;
     }
+    prof_end(PROF_SHOCK, m->event_type, prof_start);
+    if (m->event_type != KICK_OFF) {
+        ns->end_ts = tw_now(lp);
+    }
 }
 
 /* reverse event processing entry point
@@ -141,7 +151,6 @@ void lpf_shock_finalize(
     shock_state * ns,
     tw_lp * lp)
 {
-    ns->end_ts = tw_now(lp);
     printf("[shock][%lu]start_time=%lf;end_time=%lf, makespan=%lf, data_download_size=%lu, data_upload_size=%lu\n",
         lp->gid,
         ns->start_ts, 
@@ -179,11 +188,14 @@ void handle_data_download_event(
     m_remote.src = lp->gid;
     m_remote.next_hop = m->last_hop;
     strcpy(m_remote.object_id, m->object_id);
+    m_remote.obj_idx = m->obj_idx;
+    m_remote.attempt = m->attempt;
     m_remote.size =  m->size;
+    m_remote.data_type = m->data_type;
 
     //printf("[%lf][shock][%lu][StartSending]client=%lu;filesize=%llu\n", now_sec(lp), lp->gid, m->src, m->size);
 
-    model_net_event(net_id, "download", dest_id, m->size, 0.0, sizeof(awe_msg), (const void*)&m_remote, 0, NULL, lp);
+    transfer_send(lp, dest_id, &m_remote);
     
     ns->size_download += m->size;
    
@@ -196,6 +208,9 @@ void handle_data_upload_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    if (!transfer_recv(lp, m)) {
+        return;
+    }
 	//printf("[%lf][shock][%lu][Received]client=%lu;filesize=%llu...\n",  now_sec(lp), lp->gid, m->src, m->size);
     ns->size_upload += m->size;
 
@@ -209,6 +224,8 @@ void handle_data_upload_event(
     msg->next_hop = m->last_hop;
     msg->size = m->size;
     strcpy(msg->object_id, m->object_id);
+    msg->obj_idx = m->obj_idx;
+    msg->attempt = m->attempt;
     tw_event_send(e);
     return;
 }
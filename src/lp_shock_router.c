@@ -6,6 +6,11 @@
 #include "lp_shock_router.h"
 #include "util.h"
 #include "awe_types.h"
+#include "profile.h"
+#include "checkpoint.h"
+#include "obj_cache.h"
+#include "work_table.h"
+#include "transfer.h"
 
 #include "codes/model-net.h"
 #include "codes/codes.h"
@@ -25,7 +30,8 @@ struct shock_router_state {
     double time_download;
     double time_upload;
     tw_stime start_ts;    /* time that we started sending requests */
-    tw_stime end_ts;      /* time that last request finished */
+    tw_stime end_ts;      /* time of the last data transfer activity */
+    ObjCache *cache;      /* site-local object cache, NULL if disabled */
 };
 
 
@@ -79,6 +85,21 @@ tw_lpid get_shock_router_lp_id() {
     return rtn_id;
 }
 
+/* router serving a client site: SHOCK_ROUTER_SITE_<n> for AWE_CLIENT_SITE_<n>
+ * if the config defines it, the global SHOCK_ROUTER otherwise */
+tw_lpid get_site_router_lp_id(int site) {
+    tw_lpid rtn_id;
+    if (site >= 0) {
+        char grp_name[MAX_NAME_LENGTH_WKLD];
+        sprintf(grp_name, "SHOCK_ROUTER_%s", get_site_name(site) + strlen("AWE_CLIENT_"));
+        if (lp_group_exists(grp_name)) {
+            codes_mapping_get_lp_id(grp_name, "shock_router", NULL, 1, 0, 0, &rtn_id);
+            return rtn_id;
+        }
+    }
+    return get_shock_router_lp_id();
+}
+
 void lpf_shock_router_init(
 	shock_router_state * ns,
     tw_lp * lp)
@@ -88,6 +109,10 @@ void lpf_shock_router_init(
     tw_stime kickoff_time;
     
     memset(ns, 0, sizeof(*ns));
+    if (router_cache_size > 0) {
+        ns->cache = obj_cache_new((uint64_t)router_cache_size * Mega, router_cache_policy);
+        checkpoint_register_cache(lp->gid, ns->cache);
+    }
     /* skew each kickoff event slightly to help avoid event ties later on */
     kickoff_time = 0.00;
     /* first create the event (time arg is an offset, not absolute time) */
@@ -110,6 +135,7 @@ void lpf_shock_router_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    tw_clock prof_start = prof_begin();
     switch (m->event_type)
     {
         case KICK_OFF:
@@ -127,10 +153,17 @@ void lpf_shock_router_event(
         case DNLOAD_ACK:
             handle_data_download_ack_event(ns, b, m, lp);
             break;
+        case CHUNK_SENT:
+            transfer_chunk_sent(lp, m);
+            break;
         default:
 	    printf("\n shock_router Invalid message type %d \n", m->event_type);
         break;
     }
+    prof_end(PROF_SHOCK_ROUTER, m->event_type, prof_start);
+    if (m->event_type != KICK_OFF) {
+        ns->end_ts = tw_now(lp);
+    }
 }
 
 /* reverse event processing entry point
@@ -149,7 +182,6 @@ void lpf_shock_router_finalize(
     shock_router_state * ns,
     tw_lp * lp)
 {
-    ns->end_ts = tw_now(lp);
     printf("[shock_router][%lu]start_time=%lf;end_time=%lf, makespan=%lf, data_download_size=%lu, data_upload_size=%lu\n",
         lp->gid,
         ns->start_ts, 
@@ -158,6 +190,20 @@ void lpf_shock_router_finalize(
         ns->size_download,
         ns->size_upload
         );
+    if (ns->cache) {
+        printf("[shock_router][%lu]cache_capacity=%llu, cache_policy=%d, lookups=%llu, hits=%llu, hit_ratio=%lf, bytes_saved=%llu, evictions=%llu\n",
+            lp->gid,
+            (unsigned long long)ns->cache->capacity,
+            ns->cache->policy,
+            (unsigned long long)ns->cache->num_lookup,
+            (unsigned long long)ns->cache->num_hit,
+            obj_cache_hit_ratio(ns->cache),
+            (unsigned long long)ns->cache->bytes_hit,
+            (unsigned long long)ns->cache->num_evict
+            );
+        obj_cache_free(ns->cache);
+        ns->cache = NULL;
+    }
     return;
 }
 
@@ -185,6 +231,27 @@ void handle_data_download_req_event(
     awe_msg * m,
     tw_lp * lp)
 {
+    if (ns->cache && m->data_type == DATA_INPUT) {
+        char obj_id[MAX_NAME_LENGTH_WKLD];
+        Workunit* work = get_work(m->obj_idx);
+        get_input_object_id(work, obj_id);
+        if (obj_cache_lookup(ns->cache, obj_id, m->size)) {
+            /* cache hit: serve the object locally, no transfer from shock */
+            awe_msg m_remote;
+            m_remote.event_type = DNLOAD_ACK;
+            m_remote.src = lp->gid;
+            strcpy(m_remote.object_id, m->object_id);
+            m_remote.obj_idx = m->obj_idx;
+            m_remote.attempt = m->attempt;
+            m_remote.size = m->size;
+            m_remote.data_type = m->data_type;
+            fprintf(event_log, "%lf;shock_router;%lu;CH;workid=%s object=%s size=%llu\n", now_sec(lp), lp->gid, m->object_id, obj_id, (unsigned long long)m->size);
+            transfer_send(lp, m->src, &m_remote);
+            ns->size_download += m->size;
+            return;
+        }
+    }
+
     tw_event *e;
     awe_msg *msg;
     tw_lpid dest_id = m->next_hop;
@@ -194,7 +261,10 @@ void handle_data_download_req_event(
     msg->src = lp->gid;
     msg->last_hop = m->src;
     msg->size = m->size;
+    msg->data_type = m->data_type;
     strcpy(msg->object_id, m->object_id);
+    msg->obj_idx = m->obj_idx;
+    msg->attempt = m->attempt;
     tw_event_send(e);
     return;
 }
@@ -207,16 +277,30 @@ void handle_data_download_ack_event(
 {
     awe_msg m_remote;
 
+    if (!transfer_recv(lp, m)) {
+        return;
+    }
+
     tw_lpid dest_id = m->next_hop;
+
+    if (ns->cache && m->data_type == DATA_INPUT) {
+        char obj_id[MAX_NAME_LENGTH_WKLD];
+        Workunit* work = get_work(m->obj_idx);
+        get_input_object_id(work, obj_id);
+        obj_cache_insert(ns->cache, obj_id, m->size);
+    }
     
     m_remote.event_type = DNLOAD_ACK;
     m_remote.src = lp->gid;
     strcpy(m_remote.object_id, m->object_id);
+    m_remote.obj_idx = m->obj_idx;
+    m_remote.attempt = m->attempt;
     m_remote.size = m->size;
+    m_remote.data_type = m->data_type;
 
     //printf("[%lf][shock_router][%lu][StartSending]client=%lu;filesize=%llu\n", now_sec(lp), lp->gid, m->src, m->size);
 
-    model_net_event(net_id, "download", dest_id, m->size, 0.0, sizeof(awe_msg), (const void*)&m_remote, 0, NULL, lp);
+    transfer_send(lp, dest_id, &m_remote);
     ns->size_download += m->size;
     return;
 }
@@ -230,15 +314,21 @@ void handle_data_upload_req_event(
     awe_msg m_remote;
     tw_lpid dest_id = m->next_hop;
 
+    if (!transfer_recv(lp, m)) {
+        return;
+    }
+
     m_remote.event_type = UPLOAD_REQ;
     m_remote.src = lp->gid;
     m_remote.last_hop = m->src;
     strcpy(m_remote.object_id, m->object_id);
+    m_remote.obj_idx = m->obj_idx;
+    m_remote.attempt = m->attempt;
     m_remote.size = m->size;
 
     //printf("[%lf][shock_router][%lu][StartSending]client=%lu;filesize=%llu\n", now_sec(lp), lp->gid, m->src, m->size);
 
-    model_net_event(net_id, "upload", dest_id, m->size, 0.0, sizeof(awe_msg), (const void*)&m_remote, 0, NULL, lp);
+    transfer_send(lp, dest_id, &m_remote);
     ns->size_download += m->size;
 }
 
@@ -259,6 +349,8 @@ void handle_data_upload_ack_event(
     msg->src = lp->gid;
     msg->size = m->size;
     strcpy(msg->object_id, m->object_id);
+    msg->obj_idx = m->obj_idx;
+    msg->attempt = m->attempt;
     tw_event_send(e);
     return;
 }
@@ -13,6 +13,10 @@
 
 extern void register_lp_shock_router();
 extern tw_lpid get_shock_router_lp_id();
+extern tw_lpid get_site_router_lp_id(int site);
+
+extern int router_cache_size; //object cache capacity in MB, 0: caching disabled
+extern int router_cache_policy; //0: LRU, 1: size-aware (largest first)
 
 #endif	/* LP_SHOCK_ROUTER_H */
 
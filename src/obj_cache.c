@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "obj_cache.h"
+#include "arena.h"
+
+typedef struct CacheEntry CacheEntry;
+struct CacheEntry {
+    char *obj_id;
+    uint64_t size;
+    GList *link;   /* node in cache->lru */
+};
+
+/* entries are recycled across inserts and evictions of all caches */
+static Pool *entry_pool = NULL;
+
+static void free_entry(gpointer data) {
+    CacheEntry *entry = (CacheEntry*)data;
+    free(entry->obj_id);
+    pool_free(entry_pool, entry);
+}
+
+ObjCache* obj_cache_new(uint64_t capacity, int policy) {
+    if (!entry_pool) {
+        entry_pool = pool_new(sizeof(CacheEntry), 1024);
+    }
+    ObjCache *cache = malloc(sizeof(ObjCache));
+    memset(cache, 0, sizeof(ObjCache));
+    cache->capacity = capacity;
+    cache->policy = policy;
+    /* key is part of the entry thus freed with the entry */
+    cache->index = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_entry);
+    cache->lru = g_queue_new();
+    return cache;
+}
+
+void obj_cache_free(ObjCache *cache) {
+    if (!cache) {
+        return;
+    }
+    g_queue_free(cache->lru);
+    g_hash_table_destroy(cache->index);
+    free(cache);
+}
+
+/* pick the entry to evict next according to the cache policy */
+static CacheEntry* get_victim(ObjCache *cache) {
+    GList *link = g_queue_peek_tail_link(cache->lru);
+    if (!link) {
+        return NULL;
+    }
+    CacheEntry *victim = (CacheEntry*)link->data;
+    if (cache->policy == CACHE_POLICY_SIZE) {
+        /* walk from the LRU end so that the oldest of equally sized objects goes first */
+        for (link = link->prev; link; link = link->prev) {
+            CacheEntry *entry = (CacheEntry*)link->data;
+            if (entry->size > victim->size) {
+                victim = entry;
+            }
+        }
+    }
+    return victim;
+}
+
+static void evict(ObjCache *cache, CacheEntry *entry) {
+    g_queue_delete_link(cache->lru, entry->link);
+    cache->used -= entry->size;
+    cache->num_evict += 1;
+    g_hash_table_remove(cache->index, entry->obj_id);
+}
+
+/* look up an object, count the request in the statistics and refresh its recency on hit.
+ * return 1 on hit, 0 on miss */
+int obj_cache_lookup(ObjCache *cache, const char *obj_id, uint64_t size) {
+    cache->num_lookup += 1;
+    cache->bytes_lookup += size;
+    CacheEntry *entry = g_hash_table_lookup(cache->index, obj_id);
+    if (!entry) {
+        return 0;
+    }
+    cache->num_hit += 1;
+    cache->bytes_hit += size;  /* what the request is served, as counted in bytes_lookup */
+    g_queue_unlink(cache->lru, entry->link);
+    g_queue_push_head_link(cache->lru, entry->link);
+    return 1;
+}
+
+/* membership test without side effects on recency or statistics */
+int obj_cache_contains(ObjCache *cache, const char *obj_id) {
+    return g_hash_table_lookup(cache->index, obj_id) != NULL;
+}
+
+void obj_cache_insert(ObjCache *cache, const char *obj_id, uint64_t size) {
+    if (size > cache->capacity || g_hash_table_lookup(cache->index, obj_id)) {
+        return;
+    }
+    while (cache->used + size > cache->capacity) {
+        evict(cache, get_victim(cache));
+    }
+    CacheEntry *entry = pool_alloc(entry_pool);
+    entry->obj_id = strdup(obj_id);
+    entry->size = size;
+    g_queue_push_head(cache->lru, entry);
+    entry->link = g_queue_peek_head_link(cache->lru);
+    g_hash_table_insert(cache->index, entry->obj_id, entry);
+    cache->used += size;
+}
+
+double obj_cache_hit_ratio(ObjCache *cache) {
+    if (cache->num_lookup == 0) {
+        return 0.0;
+    }
+    return (double)cache->num_hit / cache->num_lookup;
+}
+
+/* visit all cached objects from the least to the most recently used, so that
+ * inserting them in this order into an empty cache restores the recency */
+void obj_cache_foreach(ObjCache *cache, void (*func)(const char *obj_id, uint64_t size, void *data), void *data) {
+    for (GList *link = g_queue_peek_tail_link(cache->lru); link; link = link->prev) {
+        CacheEntry *entry = (CacheEntry*)link->data;
+        func(entry->obj_id, entry->size, data);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ * File:   obj_cache.h
+ *
+ * Capacity-bounded data object cache, used by the shock_router to model a
+ * site-local caching proxy.
+ *
+ * Created on June 3, 2014, 2:40 PM
+ */
+
+#ifndef OBJ_CACHE_H
+#define	OBJ_CACHE_H
+
+#include <stdint.h>
+#include "glib.h"
+
+/* eviction policies */
+#define CACHE_POLICY_LRU 0   /* evict least recently used object */
+#define CACHE_POLICY_SIZE 1  /* evict largest object first, LRU among equals */
+
+typedef struct ObjCache ObjCache;
+struct ObjCache {
+    uint64_t capacity;  /* in bytes */
+    uint64_t used;      /* in bytes */
+    int policy;
+    GHashTable *index;  /* object id -> cache entry */
+    GQueue *lru;        /* cache entries, head is the most recently used */
+    /* statistics */
+    uint64_t num_lookup;
+    uint64_t num_hit;
+    uint64_t bytes_lookup;
+    uint64_t bytes_hit;
+    uint64_t num_evict;
+};
+
+ObjCache* obj_cache_new(uint64_t capacity, int policy);
+void obj_cache_free(ObjCache *cache);
+int obj_cache_lookup(ObjCache *cache, const char *obj_id, uint64_t size);
+int obj_cache_contains(ObjCache *cache, const char *obj_id);
+void obj_cache_insert(ObjCache *cache, const char *obj_id, uint64_t size);
+double obj_cache_hit_ratio(ObjCache *cache);
+void obj_cache_foreach(ObjCache *cache, void (*func)(const char *obj_id, uint64_t size, void *data), void *data);
+
+#endif	/* OBJ_CACHE_H */
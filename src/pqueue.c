@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pqueue.h"
+
+#define PQ_INIT_CAPACITY 64
+
+PQueue* pq_new(pq_less_f less, pq_set_pos_f set_pos) {
+    PQueue *pq = malloc(sizeof(PQueue));
+    memset(pq, 0, sizeof(PQueue));
+    pq->less = less;
+    pq->set_pos = set_pos;
+    return pq;
+}
+
+static void place(PQueue *pq, int pos, void *item) {
+    pq->items[pos] = item;
+    pq->set_pos(item, pos);
+}
+
+static void sift_up(PQueue *pq, int pos) {
+    void *item = pq->items[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!pq->less(item, pq->items[parent])) {
+            break;
+        }
+        place(pq, pos, pq->items[parent]);
+        pos = parent;
+    }
+    place(pq, pos, item);
+}
+
+static void sift_down(PQueue *pq, int pos) {
+    void *item = pq->items[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= pq->size) {
+            break;
+        }
+        if (child + 1 < pq->size && pq->less(pq->items[child + 1], pq->items[child])) {
+            child++;
+        }
+        if (!pq->less(pq->items[child], item)) {
+            break;
+        }
+        place(pq, pos, pq->items[child]);
+        pos = child;
+    }
+    place(pq, pos, item);
+}
+
+void pq_push(PQueue *pq, void *item) {
+    if (pq->size == pq->capacity) {
+        pq->capacity = pq->capacity ? 2 * pq->capacity : PQ_INIT_CAPACITY;
+        pq->items = realloc(pq->items, sizeof(void*) * pq->capacity);
+    }
+    pq->items[pq->size++] = item;
+    sift_up(pq, pq->size - 1);
+}
+
+void* pq_peek(PQueue *pq) {
+    return pq->size > 0 ? pq->items[0] : NULL;
+}
+
+void* pq_pop(PQueue *pq) {
+    if (pq->size == 0) {
+        return NULL;
+    }
+    void *top = pq->items[0];
+    pq_remove(pq, 0);
+    return top;
+}
+
+/* the first item in heap order match accepts, taken out, NULL if none. The
+ * items passed over are pushed back with their keys unchanged */
+void* pq_pop_match(PQueue *pq, pq_match_f match, const void *arg) {
+    void **skipped = NULL;
+    int num_skipped = 0;
+    void *item;
+    while ((item = pq_pop(pq)) && !match(item, arg)) {
+        skipped = realloc(skipped, sizeof(void*) * (num_skipped + 1));
+        skipped[num_skipped++] = item;
+    }
+    for (int i = 0; i < num_skipped; i++) {
+        pq_push(pq, skipped[i]);
+    }
+    free(skipped);
+    return item;
+}
+
+void pq_remove(PQueue *pq, int pos) {
+    void *item = pq->items[pos];
+    void *last = pq->items[--pq->size];
+    pq->set_pos(item, -1);
+    if (pos < pq->size) {
+        pq->items[pos] = last;
+        pq_update(pq, pos);
+    }
+}
+
+/* restore the order after the key of the item at pos changed */
+void pq_update(PQueue *pq, int pos) {
+    if (pos > 0 && pq->less(pq->items[pos], pq->items[(pos - 1) / 2])) {
+        sift_up(pq, pos);
+    } else {
+        sift_down(pq, pos);
+    }
+}
+
+/* restore the order after the keys of any number of items changed, in O(n) */
+void pq_heapify(PQueue *pq) {
+    for (int pos = pq->size / 2 - 1; pos >= 0; pos--) {
+        sift_down(pq, pos);
+    }
+}
+
+void pq_free(PQueue *pq) {
+    free(pq->items);
+    free(pq);
+}
@@ -0,0 +1,37 @@
+/*
+ * File:   pqueue.h
+ *
+ * Binary min-heap of pointers with a caller-defined order. The heap tells
+ * every item its current position through set_pos, so an item whose key
+ * changed can be moved, or an item taken out, in O(log n) without a search.
+ *
+ * Created on July 23, 2014, 11:05 AM
+ */
+
+#ifndef PQUEUE_H
+#define	PQUEUE_H
+
+typedef int (*pq_less_f)(const void *a, const void *b);  /* a goes before b */
+typedef void (*pq_set_pos_f)(void *item, int pos);       /* pos -1: left the heap */
+typedef int (*pq_match_f)(const void *item, const void *arg);
+
+typedef struct PQueue PQueue;
+struct PQueue {
+    void **items;
+    int size;
+    int capacity;
+    pq_less_f less;
+    pq_set_pos_f set_pos;
+};
+
+PQueue* pq_new(pq_less_f less, pq_set_pos_f set_pos);
+void pq_push(PQueue *pq, void *item);
+void* pq_peek(PQueue *pq);
+void* pq_pop(PQueue *pq);
+void* pq_pop_match(PQueue *pq, pq_match_f match, const void *arg);
+void pq_remove(PQueue *pq, int pos);
+void pq_update(PQueue *pq, int pos);
+void pq_heapify(PQueue *pq);
+void pq_free(PQueue *pq);
+
+#endif	/* PQUEUE_H */
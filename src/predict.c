@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "predict.h"
+#include "pqueue.h"
+#include "work_table.h"
+#include "util.h"
+#include "critpath.h"
+#include "lp_awe_server.h"
+#include "capability.h"
+
+int predict_oracle = 0;
+int predict_window = 64;
+
+/* running sums of a least squares fit y = a + b * x */
+typedef struct LinFit LinFit;
+struct LinFit {
+    double n;
+    double sx;
+    double sy;
+    double sxx;
+    double sxy;
+};
+
+typedef struct CmdModel CmdModel;
+struct CmdModel {
+    LinFit runtime;   /* sec against input MB */
+    LinFit outsize;   /* MB against input MB */
+    LinFit versioned; /* runtime fit as of the last version bump */
+};
+
+/* relative change of a runtime prediction that bumps the model version */
+#define VERSION_DRIFT 0.1
+
+typedef struct PredictError PredictError;
+struct PredictError {
+    uint64_t n;
+    double abs_err;
+    double signed_err;
+    uint64_t n_rel;      /* with a nonzero actual value */
+    double rel_err;
+};
+
+static GHashTable *cmd_models = NULL;  /* cmd -> CmdModel */
+static CmdModel **work_model = NULL;   /* work idx -> model of its cmd, looked up once */
+static CmdModel global_model;
+static PredictError runtime_err;
+static PredictError outsize_err;
+static uint64_t num_cold;              /* executions finished before anything was learned */
+static uint64_t model_version = 1;     /* bumped when the models change */
+
+struct Sjf {
+    PQueue *heap;   /* queued workunits, shortest predicted runtime first */
+};
+
+static uint64_t push_seq = 0;
+
+static void fit_add(LinFit *f, double x, double y) {
+    f->n += 1;
+    f->sx += x;
+    f->sy += y;
+    f->sxx += x * x;
+    f->sxy += x * y;
+}
+
+/* y at x, -1 if nothing was added yet */
+static double fit_eval(LinFit *f, double x) {
+    if (f->n == 0) {
+        return -1;
+    }
+    double mx = f->sx / f->n;
+    double my = f->sy / f->n;
+    double var = f->sxx / f->n - mx * mx;
+    if (var <= 1e-9 * (mx * mx + 1)) {  /* a single input size so far */
+        return my;
+    }
+    double y = my + (f->sxy / f->n - mx * my) / var * (x - mx);
+    return y > 0 ? y : 0;
+}
+
+static void error_add(PredictError *e, double predicted, double actual) {
+    e->n++;
+    e->abs_err += fabs(predicted - actual);
+    e->signed_err += predicted - actual;
+    if (actual > 0) {
+        e->n_rel++;
+        e->rel_err += fabs(predicted - actual) / actual;
+    }
+}
+
+static CmdModel* get_model(Workunit *work) {
+    if (!work_model) {  /* the traces are parsed after predict_init */
+        work_model = calloc(num_works, sizeof(CmdModel*));
+    }
+    CmdModel *m = work_model[work->idx];
+    if (!m) {
+        m = g_hash_table_lookup(cmd_models, work->cmd);
+        if (!m) {
+            m = calloc(1, sizeof(CmdModel));
+            g_hash_table_insert(cmd_models, g_strdup(work->cmd), m);
+        }
+        work_model[work->idx] = m;
+    }
+    return m;
+}
+
+static double input_mb(Workunit *work) {
+    return work_params.size_infile[work->idx] / (double)Mega;
+}
+
+void predict_init() {
+    if (cmd_models) {
+        g_hash_table_destroy(cmd_models);
+        free(work_model);
+        work_model = NULL;
+    }
+    cmd_models = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free);
+    memset(&global_model, 0, sizeof(CmdModel));
+    memset(&runtime_err, 0, sizeof(PredictError));
+    memset(&outsize_err, 0, sizeof(PredictError));
+    num_cold = 0;
+    model_version = 1;
+}
+
+/* runtime, or output size if out, at x MB of input by the cmd's fit, by the
+ * fit over all cmds if the cmd never finished, -1 if nothing did */
+static double predict_at(Workunit *work, int out, double x) {
+    CmdModel *m = get_model(work);
+    double y = fit_eval(out ? &m->outsize : &m->runtime, x);
+    if (y < 0) {
+        y = fit_eval(out ? &global_model.outsize : &global_model.runtime, x);
+    }
+    return y;
+}
+
+static double predict(Workunit *work, int out) {
+    return predict_at(work, out, input_mb(work));
+}
+
+/* in sec */
+double predict_runtime(Workunit *work) {
+    if (predict_oracle) {
+        return work_params.runtime[work->idx];
+    }
+    double y = predict(work, 0);
+    return y > 0 ? y : 0;
+}
+
+/* in sec, of a workunit of the same cmd with input_mb MB of input, learned
+ * model only */
+double predict_runtime_at(Workunit *work, double input_mb) {
+    double y = predict_at(work, 0, input_mb);
+    return y > 0 ? y : 0;
+}
+
+/* in bytes */
+double predict_outsize(Workunit *work) {
+    if (predict_oracle) {
+        return work_params.size_outfile[work->idx];
+    }
+    double y = predict(work, 1);
+    return y > 0 ? y * Mega : 0;
+}
+
+/* the runtime fit moved at x by more than VERSION_DRIFT since the last bump */
+static int drifted(CmdModel *m, double x) {
+    double before = fit_eval(&m->versioned, x);
+    double now = fit_eval(&m->runtime, x);
+    if (before <= 0) {
+        return now > 0;
+    }
+    return fabs(now - before) > VERSION_DRIFT * before;
+}
+
+/* learn from an execution run to completion, runtime in sec without checkpoint overhead */
+void predict_observe(Workunit *work, double runtime, uint64_t outsize) {
+    double out_mb = outsize / (double)Mega;
+    double p_runtime = predict(work, 0);
+    double p_outsize = predict(work, 1);
+    if (p_runtime < 0) {
+        num_cold++;
+    } else {
+        error_add(&runtime_err, p_runtime, runtime);
+        error_add(&outsize_err, p_outsize, out_mb);
+    }
+    CmdModel *m = get_model(work);
+    double x = input_mb(work);
+    fit_add(&m->runtime, x, runtime);
+    fit_add(&m->outsize, x, out_mb);
+    fit_add(&global_model.runtime, x, runtime);
+    fit_add(&global_model.outsize, x, out_mb);
+    if (predict_oracle) {
+        return;
+    }
+    /* keys taken from the predictions are rebuilt on a version bump, so only
+     * bump when a runtime prediction moved noticeably, at the input size seen */
+    int bump = 0;
+    if (drifted(m, x)) {
+        m->versioned = m->runtime;
+        bump = 1;
+    }
+    if (drifted(&global_model, x)) {
+        global_model.versioned = global_model.runtime;
+        bump = 1;
+    }
+    if (bump) {
+        model_version++;
+    }
+}
+
+/* changes whenever a runtime prediction moved by more than VERSION_DRIFT at the
+ * input size just observed, never 0 */
+uint64_t predict_version() {
+    return model_version;
+}
+
+/* among the first predict_window queued workunits a client of class cls can run
+ * (-1: any class) the one with the most predicted compute per byte moved,
+ * removed from the queue, NULL if there is none */
+Workunit* predict_pick_remote(GQueue *work_queue, int cls) {
+    GList *best = NULL;
+    double best_ratio = -1;
+    int i = 0;
+    for (GList *link = g_queue_peek_head_link(work_queue); link && i < predict_window; link = link->next) {
+        Workunit *work = (Workunit*)link->data;
+        if (!cap_class_match(cls, work)) {
+            continue;
+        }
+        i++;
+        int w = work->idx;
+        double bytes = work_params.size_infile[w] + work_params.size_predata[w] + predict_outsize(work);
+        double ratio = predict_runtime(work) / (bytes / Mega + 1);
+        if (ratio > best_ratio) {
+            best_ratio = ratio;
+            best = link;
+        }
+    }
+    if (!best) {
+        return NULL;
+    }
+    Workunit *work = best->data;
+    g_queue_delete_link(work_queue, best);
+    return work;
+}
+
+static void error_print(const char *name, const char *unit, PredictError *e) {
+    printf(",%s_mae%s=%lf,%s_bias%s=%lf,%s_mape=%.2lf",
+        name, unit, e->n > 0 ? e->abs_err / e->n : 0.0,
+        name, unit, e->n > 0 ? e->signed_err / e->n : 0.0,
+        name, e->n_rel > 0 ? 100.0 * e->rel_err / e->n_rel : 0.0);
+}
+
+void predict_report() {
+    if (!cmd_models || (sched_policy != SCHED_CRITPATH && sched_policy != SCHED_SJF && sched_policy != SCHED_PREDICT_DATA)) {
+        return;
+    }
+    printf("[predict]oracle=%d,cmds=%u,observed=%llu,cold=%llu",
+        predict_oracle,
+        g_hash_table_size(cmd_models),
+        (unsigned long long)(runtime_err.n + num_cold),
+        (unsigned long long)num_cold);
+    error_print("runtime", "", &runtime_err);
+    error_print("outsize", "_mb", &outsize_err);
+    printf("\n");
+}
+
+static int work_before(const void *a, const void *b) {
+    const WorkRun *ra = &work_runs[((const Workunit*)a)->idx];
+    const WorkRun *rb = &work_runs[((const Workunit*)b)->idx];
+    if (ra->pred_runtime != rb->pred_runtime) {
+        return ra->pred_runtime < rb->pred_runtime;
+    }
+    return ra->queue_seq < rb->queue_seq;
+}
+
+static void work_set_pos(void *item, int pos) {
+    work_runs[((Workunit*)item)->idx].heap_pos = pos;
+}
+
+Sjf* sjf_new() {
+    Sjf *sjf = malloc(sizeof(Sjf));
+    sjf->heap = pq_new(work_before, work_set_pos);
+    return sjf;
+}
+
+/* the prediction is taken when the workunit is queued and kept while it waits.
+ * at_head: first among the workunits of the same prediction */
+void sjf_push(Sjf *sjf, Workunit *work, int at_head) {
+    work_runs[work->idx].pred_runtime = predict_runtime(work);
+    work_runs[work->idx].queue_seq = at_head ? 0 : ++push_seq;
+    pq_push(sjf->heap, work);
+}
+
+static int class_match(const void *item, const void *arg) {
+    return cap_class_match(*(const int*)arg, (Workunit*)item);
+}
+
+/* the shortest workunit a client of class cls can run, -1: any class */
+Workunit* sjf_pop(Sjf *sjf, int cls) {
+    return cls < 0 ? pq_pop(sjf->heap) : pq_pop_match(sjf->heap, class_match, &cls);
+}
+
+/* take a queued workunit out, when it is stolen */
+void sjf_remove(Sjf *sjf, Workunit *work) {
+    pq_remove(sjf->heap, work_runs[work->idx].heap_pos);
+}
@@ -0,0 +1,64 @@
+/*
+ * File:   predict.h
+ *
+ * Runtime and output size prediction. Production AWE does not know how long
+ * a workunit will run, so policies that rank workunits by their trace runtime
+ * see an oracle. Instead every completed execution is fed to a per-command
+ * least squares fit of runtime and output size against input size, and the
+ * policies ask the fit. A command without two distinct input sizes yet gets
+ * its mean, one never seen the fit over all commands, and before anything
+ * finished the prediction is 0. Runtimes are learned and predicted at client
+ * speed 1, see capability.h. --predict-oracle=1 answers with the trace
+ * numbers instead, to compare against the learned estimates.
+ *
+ * The models have a version, so that keys derived from the predictions can
+ * tell when they are stale. It is bumped when an execution learned from moves
+ * the runtime prediction of its cmd, or the one over all cmds, at its input
+ * size by more than 10% since the last bump, not on every execution.
+ *
+ * The error of each prediction is taken before its execution is learned
+ * from, and reported as mean absolute and mean absolute percentage error.
+ *
+ * Policies reading the predictions:
+ *   sched_policy 5, critical-path: task cost, see critpath.h
+ *   sched_policy 6, shortest-job-first: each awe_server hands out the queued
+ *     workunit with the shortest predicted runtime, FIFO on ties
+ *   sched_policy 7, predicted data-aware: a remote client takes, among the
+ *     first --predict-window queued workunits, the one with the most
+ *     predicted compute per byte moved (input, predata, predicted output);
+ *     local clients take the queue head
+ *
+ * Created on July 28, 2014, 10:15 AM
+ */
+
+#ifndef PREDICT_H
+#define	PREDICT_H
+
+#include <stdint.h>
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+#define SCHED_SJF 6
+#define SCHED_PREDICT_DATA 7
+
+extern int predict_oracle;   //1: predictions are the trace numbers
+extern int predict_window;   //queued workunits looked at by sched_policy 7
+
+typedef struct Sjf Sjf;
+
+void predict_init();
+double predict_runtime(Workunit *work);
+double predict_runtime_at(Workunit *work, double input_mb);
+double predict_outsize(Workunit *work);
+void predict_observe(Workunit *work, double runtime, uint64_t outsize);
+uint64_t predict_version();
+Workunit* predict_pick_remote(GQueue *work_queue, int cls);
+void predict_report();
+
+Sjf* sjf_new();
+void sjf_push(Sjf *sjf, Workunit *work, int at_head);
+Workunit* sjf_pop(Sjf *sjf, int cls);
+void sjf_remove(Sjf *sjf, Workunit *work);
+
+#endif	/* PREDICT_H */
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "profile.h"
+
+int profile_enabled = 0;
+ProfCounter prof_counters[PROF_NUM_LP_TYPES][PROF_MAX_EVENT_TYPES];
+
+static double phase_time[PROF_NUM_PHASES];
+
+static const char* lp_type_names[PROF_NUM_LP_TYPES] = {
+    "awe_server",
+    "awe_client",
+    "shock",
+    "shock_router",
+};
+
+static const char* phase_names[PROF_NUM_PHASES] = {
+    "configuration_load",
+    "parse_jobtrace",
+    "parse_worktrace",
+    "jobmap_cleaning",
+    "codes_mapping_setup",
+    "startup",
+    "tw_run",
+};
+
+/* monotonic wall clock in sec */
+double prof_wall_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void prof_phase_add(prof_phase phase, double seconds) {
+    phase_time[phase] += seconds;
+}
+
+void profile_report() {
+    if (!profile_enabled) {
+        return;
+    }
+    for (int p = 0; p < PROF_NUM_PHASES; p++) {
+        printf("[profile]phase=%s, wall_time=%lf\n", phase_names[p], phase_time[p]);
+    }
+    uint64_t total_events = 0;
+    double total_handler_time = 0;
+    for (int t = 0; t < PROF_NUM_LP_TYPES; t++) {
+        for (int e = 0; e < PROF_MAX_EVENT_TYPES; e++) {
+            ProfCounter *c = &prof_counters[t][e];
+            if (c->count == 0) {
+                continue;
+            }
+            double seconds = c->cycles / g_tw_clock_rate;
+            printf("[profile]lp_type=%s, event_type=%d, events=%llu, cycles=%llu, time=%lf, cycles_per_event=%.1lf\n",
+                lp_type_names[t],
+                e,
+                (unsigned long long)c->count,
+                (unsigned long long)c->cycles,
+                seconds,
+                (double)c->cycles / c->count);
+            total_events += c->count;
+            total_handler_time += seconds;
+        }
+    }
+    double run_time = phase_time[PROF_PHASE_RUN];
+    /* time outside the awesim handlers: model-net, ROSS scheduler, event queue */
+    printf("[profile]awesim_events=%llu, handler_time=%lf, other_time=%lf, awesim_events_per_sec=%lf\n",
+        (unsigned long long)total_events,
+        total_handler_time,
+        run_time - total_handler_time,
+        run_time > 0 ? total_events / run_time : 0.0);
+}
+
+/* one machine-readable line for the benchmark scripts, printed whether or not
+ * profiling is enabled */
+void profile_summary() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long peak_rss_kb = usage.ru_maxrss;
+#ifdef __APPLE__
+    peak_rss_kb /= 1024;  /* bytes on OS X, KB on Linux */
+#endif
+    tw_stat committed = g_tw_pe[0]->stats.s_nevent_processed - g_tw_pe[0]->stats.s_e_rbs;
+    double startup_time = phase_time[PROF_PHASE_STARTUP];
+    double run_time = phase_time[PROF_PHASE_RUN];
+    printf("[awesim-summary]wall_time=%lf,startup_time=%lf,run_time=%lf,committed_events=%llu,events_per_sec=%lf,peak_rss_kb=%ld\n",
+        startup_time + run_time,
+        startup_time,
+        run_time,
+        (unsigned long long)committed,
+        run_time > 0 ? committed / run_time : 0.0,
+        peak_rss_kb);
+}
@@ -0,0 +1,66 @@
+/*
+ * File:   profile.h
+ *
+ * Optional self-profiling of the simulator: event counts and cycles spent in
+ * the event handlers per (LP type, awe_event_type), and wall time of the
+ * startup phases. With profiling disabled an event costs one branch.
+ *
+ * Created on June 24, 2014, 11:20 AM
+ */
+
+#ifndef PROFILE_H
+#define	PROFILE_H
+
+#include <stdint.h>
+#include "ross.h"
+
+typedef enum prof_lp_type prof_lp_type;
+enum prof_lp_type {
+    PROF_AWE_SERVER,
+    PROF_AWE_CLIENT,
+    PROF_SHOCK,
+    PROF_SHOCK_ROUTER,
+    PROF_NUM_LP_TYPES
+};
+
+typedef enum prof_phase prof_phase;
+enum prof_phase {
+    PROF_PHASE_CONFIG_LOAD,
+    PROF_PHASE_PARSE_JOBTRACE,
+    PROF_PHASE_PARSE_WORKTRACE,
+    PROF_PHASE_JOBMAP_CLEANING,
+    PROF_PHASE_MAPPING_SETUP,
+    PROF_PHASE_STARTUP,  /* everything before tw_run, includes the phases above */
+    PROF_PHASE_RUN,
+    PROF_NUM_PHASES
+};
+
+#define PROF_MAX_EVENT_TYPES 32
+
+typedef struct ProfCounter ProfCounter;
+struct ProfCounter {
+    uint64_t count;
+    tw_clock cycles;
+};
+
+extern int profile_enabled;
+extern ProfCounter prof_counters[PROF_NUM_LP_TYPES][PROF_MAX_EVENT_TYPES];
+
+static inline tw_clock prof_begin() {
+    return profile_enabled ? tw_clock_read() : 0;
+}
+
+static inline void prof_end(prof_lp_type lp_type, int event_type, tw_clock start) {
+    if (profile_enabled && event_type >= 0 && event_type < PROF_MAX_EVENT_TYPES) {
+        ProfCounter *c = &prof_counters[lp_type][event_type];
+        c->count += 1;
+        c->cycles += tw_clock_read() - start;
+    }
+}
+
+double prof_wall_time();
+void prof_phase_add(prof_phase phase, double seconds);
+void profile_report();
+void profile_summary();
+
+#endif	/* PROFILE_H */
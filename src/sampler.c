@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sampler.h"
+#include "util.h"
+#include "lp_shock.h"
+#include "lp_shock_router.h"
+
+#include "codes/configuration.h"
+
+int sample_interval = 0;
+char sample_file_name[256] = {0};
+
+static FILE *sample_file = NULL;
+
+/* queues of each awe_server */
+static int num_servers = 0;
+static GQueue* server_work_queue[MAX_NUM_SITES];
+static GQueue* server_client_req_queue[MAX_NUM_SITES];
+
+/* clients per site */
+static int clients_total[MAX_NUM_SITES];
+static int clients_busy[MAX_NUM_SITES];
+
+/* links between lp groups: column of each (src group, dest group) pair, the
+ * last column collects transfers over links not known at startup */
+static int num_groups = 0;
+static int *link_col = NULL;
+static int num_links = 0;
+static char (*link_names)[2 * MAX_NAME_LENGTH_WKLD];
+static int64_t *link_inflight = NULL;
+
+static int get_group_idx_by_name(const char* name) {
+    for (int i = 0; i < lpconf.lpgroups_count; i++) {
+        if (strcmp(lpconf.lpgroups[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void add_link(int src_grp, int dest_grp) {
+    if (link_col[src_grp * num_groups + dest_grp] >= 0) {
+        return;
+    }
+    link_col[src_grp * num_groups + dest_grp] = num_links;
+    sprintf(link_names[num_links], "%s>%s", lpconf.lpgroups[src_grp].name, lpconf.lpgroups[dest_grp].name);
+    num_links += 1;
+}
+
+/* the links data moves over: shock <-> router and router <-> client site, for every site */
+static void init_links() {
+    num_groups = lpconf.lpgroups_count;
+    link_col = malloc(sizeof(int) * num_groups * num_groups);
+    for (int i = 0; i < num_groups * num_groups; i++) {
+        link_col[i] = -1;
+    }
+    link_names = malloc(sizeof(*link_names) * (4 * get_num_sites() + 1));
+    int shock_grp = get_lp_group_idx(get_shock_lp_id());
+    for (int s = 0; s < get_num_sites(); s++) {
+        int router_grp = get_lp_group_idx(get_site_router_lp_id(s));
+        int site_grp = get_group_idx_by_name(get_site_name(s));
+        add_link(shock_grp, router_grp);
+        add_link(router_grp, shock_grp);
+        add_link(router_grp, site_grp);
+        add_link(site_grp, router_grp);
+    }
+    strcpy(link_names[num_links], "other");
+    link_inflight = calloc(num_links + 1, sizeof(int64_t));
+}
+
+void sampler_register_server(int server_idx, GQueue* work_queue, GQueue* client_req_queue) {
+    assert(server_idx < MAX_NUM_SITES);
+    server_work_queue[server_idx] = work_queue;
+    server_client_req_queue[server_idx] = client_req_queue;
+    if (server_idx >= num_servers) {
+        num_servers = server_idx + 1;
+    }
+}
+
+void sampler_client_active(int site, int delta) {
+    if (site >= 0) {
+        clients_total[site] += delta;
+    }
+}
+
+void sampler_client_busy(int site, int delta) {
+    if (site >= 0) {
+        clients_busy[site] += delta;
+    }
+}
+
+/* account bytes put on (delta > 0) or taken off (delta < 0) the link from src to dest */
+void sampler_link_bytes(tw_lpid src, tw_lpid dest, int64_t delta) {
+    if (sample_interval <= 0) {
+        return;
+    }
+    if (!link_col) {
+        init_links();
+    }
+    int col = link_col[get_lp_group_idx(src) * num_groups + get_lp_group_idx(dest)];
+    link_inflight[col >= 0 ? col : num_links] += delta;
+}
+
+static void write_header() {
+    fprintf(sample_file, "time");
+    for (int i = 0; i < num_servers; i++) {
+        fprintf(sample_file, ",work_queue_%d,client_req_queue_%d", i, i);
+    }
+    for (int s = 0; s < get_num_sites(); s++) {
+        fprintf(sample_file, ",busy_%s,idle_%s", get_site_name(s), get_site_name(s));
+    }
+    for (int i = 0; i <= num_links; i++) {
+        fprintf(sample_file, ",inflight_%s", link_names[i]);
+    }
+    fprintf(sample_file, "\n");
+}
+
+void sampler_write_sample(double now) {
+    if (!sample_file) {
+        sample_file = fopen(sample_file_name[0] ? sample_file_name : "awesim_samples.csv", "w");
+        if (sample_file == NULL) {
+            perror(sample_file_name);
+            exit(1);
+        }
+        if (!link_col) {
+            init_links();
+        }
+        write_header();
+    }
+    fprintf(sample_file, "%.3lf", now);
+    for (int i = 0; i < num_servers; i++) {
+        fprintf(sample_file, ",%u,%u", g_queue_get_length(server_work_queue[i]), g_queue_get_length(server_client_req_queue[i]));
+    }
+    for (int s = 0; s < get_num_sites(); s++) {
+        fprintf(sample_file, ",%d,%d", clients_busy[s], clients_total[s] - clients_busy[s]);
+    }
+    for (int i = 0; i <= num_links; i++) {
+        fprintf(sample_file, ",%lld", (long long)link_inflight[i]);
+    }
+    fprintf(sample_file, "\n");
+}
+
+void sampler_close() {
+    if (sample_file) {
+        fclose(sample_file);
+        sample_file = NULL;
+    }
+}
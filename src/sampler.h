@@ -0,0 +1,27 @@
+/*
+ * File:   sampler.h
+ *
+ * Periodic time series of queue depths, busy/idle clients per site and bytes
+ * in flight per network link, written as one CSV row per sample interval.
+ *
+ * Created on June 17, 2014, 10:05 AM
+ */
+
+#ifndef SAMPLER_H
+#define	SAMPLER_H
+
+#include <stdint.h>
+#include "glib.h"
+#include "ross.h"
+
+extern int sample_interval;  //simulated seconds between samples, 0: sampling disabled
+extern char sample_file_name[256];
+
+void sampler_register_server(int server_idx, GQueue* work_queue, GQueue* client_req_queue);
+void sampler_client_active(int site, int delta);
+void sampler_client_busy(int site, int delta);
+void sampler_link_bytes(tw_lpid src, tw_lpid dest, int64_t delta);
+void sampler_write_sample(double now);
+void sampler_close();
+
+#endif	/* SAMPLER_H */
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "straggler.h"
+#include "histogram.h"
+#include "util.h"
+
+char slowdown_spec[256] = {0};
+int spec_percentile = 0;
+int spec_min_samples = 20;
+
+SpecStats spec_stats;
+
+typedef enum slowdown_dist slowdown_dist;
+enum slowdown_dist {
+    SLOWDOWN_NONE,
+    SLOWDOWN_LOGNORMAL,
+    SLOWDOWN_PARETO,
+    SLOWDOWN_BIMODAL,
+};
+
+typedef struct Slowdown Slowdown;
+struct Slowdown {
+    slowdown_dist dist;
+    double a;
+    double b;
+};
+
+static Slowdown site_slowdown[MAX_NUM_SITES];
+
+/* "dist:a[:b]" into sd, return 0 if the distribution is unknown */
+static int parse_slowdown(gchar **f, Slowdown *sd) {
+    memset(sd, 0, sizeof(Slowdown));
+    if (!f[0] || strcmp(f[0], "none") == 0) {
+        return 1;
+    }
+    double a = f[1] ? atof(f[1]) : 0;
+    double b = f[1] && f[2] ? atof(f[2]) : 0;
+    if (strcmp(f[0], "lognormal") == 0) {
+        sd->dist = SLOWDOWN_LOGNORMAL;
+    } else if (strcmp(f[0], "pareto") == 0 && a > 0) {
+        sd->dist = SLOWDOWN_PARETO;
+    } else if (strcmp(f[0], "bimodal") == 0 && b >= 1) {
+        sd->dist = SLOWDOWN_BIMODAL;
+    } else {
+        return 0;
+    }
+    sd->a = a;
+    sd->b = b;
+    return 1;
+}
+
+void straggler_init() {
+    memset(&spec_stats, 0, sizeof(SpecStats));
+    memset(site_slowdown, 0, sizeof(site_slowdown));
+    if (!slowdown_spec[0]) {
+        return;
+    }
+    int site_set[MAX_NUM_SITES] = {0};
+    gchar **entries = g_strsplit(slowdown_spec, ",", MAX_NUM_SITES + 1);
+    /* entries for all sites first, so that site entries override them wherever they are listed */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; entries[i]; i++) {
+            gchar **f = g_strsplit(entries[i], ":", 4);
+            int has_site = f[0] && g_ascii_isdigit(f[0][0]);
+            if (has_site == pass) {
+                Slowdown sd;
+                if (!parse_slowdown(f + has_site, &sd)) {
+                    fprintf(stderr, "unknown slowdown \"%s\", see straggler.h\n", entries[i]);
+                    exit(1);
+                }
+                for (int s = 0; s < MAX_NUM_SITES; s++) {
+                    if (has_site ? s == atoi(f[0]) : !site_set[s]) {
+                        site_slowdown[s] = sd;
+                        site_set[s] = has_site;
+                    }
+                }
+            }
+            g_strfreev(f);
+        }
+    }
+    g_strfreev(entries);
+}
+
+/* factor the runtime of one execution on a client of the site is multiplied by */
+double straggler_slowdown(int site, tw_lp *lp) {
+    Slowdown *sd = &site_slowdown[site < 0 ? 0 : site];
+    double u;
+    switch (sd->dist) {
+        case SLOWDOWN_LOGNORMAL:
+            u = tw_rand_unif(lp->rng);
+            return exp(sd->a * sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * tw_rand_unif(lp->rng)));
+        case SLOWDOWN_PARETO:
+            return pow(1.0 - tw_rand_unif(lp->rng), -1.0 / sd->a);
+        case SLOWDOWN_BIMODAL:
+            return tw_rand_unif(lp->rng) * 100 < sd->a ? sd->b : 1.0;
+        default:
+            return 1.0;
+    }
+}
+
+/* running time after which a workunit of the stage gets a duplicate, -1: none */
+double spec_threshold(int stage) {
+    if (spec_percentile <= 0 || stage < 0 || stage >= MAX_NUM_TASKS) {
+        return -1;
+    }
+    Histogram *h = latency_get_stage(LAT_WORK_EXEC, stage);
+    if (h->count < (uint64_t)spec_min_samples) {
+        return -1;
+    }
+    return hist_percentile(h, spec_percentile / 100.0);
+}
+
+void straggler_report() {
+    if (!slowdown_spec[0] && spec_percentile <= 0) {
+        return;
+    }
+    Histogram *exec = latency_get(LAT_WORK_EXEC);
+    double total_compute = spec_stats.compute_time + spec_stats.wasted_compute;
+    printf("[straggler]slowdown=%s,spec_percentile=%d,duplicates=%llu,won_by_duplicate=%llu,cancelled=%llu,late=%llu,"
+        "work_exec_p50=%lf,work_exec_p99=%lf,wasted_compute=%lf,wasted_compute_pct=%.2lf,wasted_transfer_mb=%.1lf\n",
+        slowdown_spec[0] ? slowdown_spec : "none",
+        spec_percentile,
+        (unsigned long long)spec_stats.num_duplicates,
+        (unsigned long long)spec_stats.num_won,
+        (unsigned long long)spec_stats.num_cancelled,
+        (unsigned long long)spec_stats.num_late,
+        hist_percentile(exec, 0.50),
+        hist_percentile(exec, 0.99),
+        spec_stats.wasted_compute,
+        total_compute > 0 ? 100.0 * spec_stats.wasted_compute / total_compute : 0.0,
+        spec_stats.wasted_bytes / (double)Mega);
+}
@@ -0,0 +1,50 @@
+/*
+ * File:   straggler.h
+ *
+ * Runtime variability and speculative execution. A client runs a workunit
+ * for its trace runtime times a slowdown drawn per execution from the
+ * distribution of its site, given by --slowdown as a comma separated list of
+ * [site:]dist entries, an entry without site applying to all other sites:
+ *   none              no slowdown
+ *   lognormal:sigma   exp(sigma * N(0,1)), median 1
+ *   pareto:alpha      Pareto with minimum 1
+ *   bimodal:pct:f     slowed down by f in pct percent of the executions
+ * e.g. --slowdown=lognormal:0.3,1:bimodal:10:5
+ *
+ * With --spec-percentile the server that checked out a workunit dispatches
+ * a duplicate once it has run longer than that percentile of the checkout to
+ * done times of its stage. The first copy done wins and the other one is
+ * cancelled on its client.
+ *
+ * Created on July 14, 2014, 4:20 PM
+ */
+
+#ifndef STRAGGLER_H
+#define	STRAGGLER_H
+
+#include <stdint.h>
+#include "ross.h"
+
+extern char slowdown_spec[256];
+extern int spec_percentile;   //0: no speculative execution
+extern int spec_min_samples;  //finished workunits of a stage needed before its threshold is used
+
+typedef struct SpecStats SpecStats;
+struct SpecStats {
+    uint64_t num_duplicates;   /* duplicates dispatched */
+    uint64_t num_won;          /* workunits finished first by their duplicate */
+    uint64_t num_cancelled;    /* copies cancelled on a client */
+    uint64_t num_late;         /* copies done before their cancel arrived */
+    double compute_time;       /* compute sec of all copies run to completion */
+    double wasted_compute;     /* compute sec of cancelled and late copies */
+    uint64_t wasted_bytes;     /* transferred by cancelled and late copies */
+};
+
+extern SpecStats spec_stats;
+
+void straggler_init();
+double straggler_slowdown(int site, tw_lp *lp);
+double spec_threshold(int stage);
+void straggler_report();
+
+#endif	/* STRAGGLER_H */
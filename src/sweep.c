@@ -0,0 +1,314 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "glib.h"
+#include "util.h"
+#include "lp_awe_server.h"
+#include "sweep.h"
+
+char sweep_file_name[256] = {0};
+int sweep_workers = 0;
+char sweep_dir[256] = "sweep";
+
+static SweepConfig *child_config = NULL;  /* configuration of this process if it is a forked run */
+
+/* value of a --name=value option, for use before tw_init parses argv */
+static const char* get_opt(int argc, char **argv, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, len) == 0 && argv[i][2 + len] == '=') {
+            return argv[i] + 3 + len;
+        }
+    }
+    return NULL;
+}
+
+static SweepConfig* parse_sweep_file(const char *path, int *num_configs) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    char line[MAX_LEN_TRACE_LINE];
+    SweepConfig *configs = NULL;
+    int n = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        g_strstrip(line);
+        if (line[0] == 0 || line[0] == '#') {
+            continue;
+        }
+        configs = realloc(configs, sizeof(SweepConfig) * (n + 1));
+        SweepConfig *sc = &configs[n];
+        memset(sc, 0, sizeof(SweepConfig));
+        sc->sched_policy = -1;
+        sc->clients = -1;
+        sc->fraction = -1;
+        sc->spec_percentile = -1;
+        gchar **parts = g_strsplit(line, ";", 30);
+        for (int i = 0; parts[i]; i++) {
+            gchar **pair = g_strsplit(parts[i], "=", 2);
+            char *key = pair[0];
+            char *val = pair[1];
+            if (val) {
+                if (strcmp(key, "name") == 0) {
+                    strncpy(sc->name, val, MAX_NAME_LENGTH_WKLD - 1);
+                } else if (strcmp(key, "sched_policy") == 0) {
+                    sc->sched_policy = atoi(val);
+                } else if (strcmp(key, "clients") == 0) {
+                    sc->clients = atoi(val);
+                } else if (strcmp(key, "fraction") == 0) {
+                    sc->fraction = atoi(val);
+                } else if (strcmp(key, "bw_file") == 0) {
+                    strncpy(sc->bw_file, val, MAX_NAME_LENGTH_WKLD - 1);
+                } else if (strcmp(key, "slowdown") == 0) {
+                    strncpy(sc->slowdown, val, MAX_NAME_LENGTH_WKLD - 1);
+                } else if (strcmp(key, "spec_percentile") == 0) {
+                    sc->spec_percentile = atoi(val);
+                } else if (strcmp(key, "failures") == 0) {
+                    strncpy(sc->failures, val, MAX_NAME_LENGTH_WKLD - 1);
+                } else if (strcmp(key, "autoscale") == 0) {
+                    strncpy(sc->autoscale, val, MAX_NAME_LENGTH_WKLD - 1);
+                }
+            }
+            g_strfreev(pair);
+        }
+        g_strfreev(parts);
+        if (sc->name[0] == 0) {
+            sprintf(sc->name, "run%d", n);
+        }
+        n++;
+    }
+    fclose(f);
+    *num_configs = n;
+    return configs;
+}
+
+/* copy of the base codes config with the run's client count and bandwidth
+ * matrix. it is written next to the base config so that relative file names
+ * in it resolve the same way */
+static void make_codes_config(const char *base_path, SweepConfig *sc) {
+    snprintf(sc->codes_config, MAX_NAME_LENGTH_WKLD, "%s.sweep-%s", base_path, sc->name);
+    FILE *in = fopen(base_path, "r");
+    FILE *out = fopen(sc->codes_config, "w");
+    if (in == NULL || out == NULL) {
+        perror(in ? sc->codes_config : base_path);
+        exit(1);
+    }
+    char line[MAX_LEN_TRACE_LINE];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char *placeholder = strstr(line, "#clients");
+        if (placeholder && sc->clients >= 0) {
+            fprintf(out, "%.*s%d%s", (int)(placeholder - line), line, sc->clients, placeholder + strlen("#clients"));
+        } else if (strstr(line, "net_bw_mbps_file") && sc->bw_file[0]) {
+            fprintf(out, "    net_bw_mbps_file=\"%s\";\n", sc->bw_file);
+        } else {
+            fputs(line, out);
+        }
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/* value of key in a "[tag]key=value,key=value" summary line, 0 if absent */
+static double get_field(const char *line, const char *key) {
+    size_t len = strlen(key);
+    for (const char *p = strstr(line, key); p; p = strstr(p + 1, key)) {
+        if ((p[-1] == ']' || p[-1] == ',') && p[len] == '=') {
+            return atof(p + len + 1);
+        }
+    }
+    return 0;
+}
+
+static void report_sweep(SweepConfig *configs, int *status, int n) {
+    char path[MAX_NAME_LENGTH_WKLD];
+    snprintf(path, sizeof(path), "%s/sweep_results.csv", sweep_dir);
+    FILE *csv = fopen(path, "w");
+    if (csv == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(csv, "name,sched_policy,clients,fraction,bw_file,slowdown,spec_percentile,failures,autoscale,exit_status,jobs_done,makespan,turnaround_mean,turnaround_p95,work_wait_mean,work_exec_p99,wasted_compute_pct,lost_compute,requeued,client_hours,turnaround_jain,runtime_mape,wall_time,events_per_sec,peak_rss_kb\n");
+    printf("%-20s %6s %7s %8s %6s %9s %12s %12s %12s %12s %9s %12s %10s\n",
+        "name", "policy", "clients", "fraction", "status", "jobs_done", "makespan", "turnaround", "turnaround95", "work_wait", "wall_time", "events/sec", "rss_kb");
+    for (int i = 0; i < n; i++) {
+        SweepConfig *sc = &configs[i];
+        char result[MAX_LEN_TRACE_LINE] = {0};
+        char summary[MAX_LEN_TRACE_LINE] = {0};
+        char straggler[MAX_LEN_TRACE_LINE] = {0};
+        char failure[MAX_LEN_TRACE_LINE] = {0};
+        char autoscale[MAX_LEN_TRACE_LINE] = {0};
+        char fairshare[MAX_LEN_TRACE_LINE] = {0};
+        char predict[MAX_LEN_TRACE_LINE] = {0};
+        char line[MAX_LEN_TRACE_LINE];
+        snprintf(path, sizeof(path), "%s/%s.out", sweep_dir, sc->name);
+        FILE *f = fopen(path, "r");
+        while (f && fgets(line, sizeof(line), f) != NULL) {
+            if (g_str_has_prefix(line, "[awesim-result]")) {
+                strcpy(result, line);
+            } else if (g_str_has_prefix(line, "[awesim-summary]")) {
+                strcpy(summary, line);
+            } else if (g_str_has_prefix(line, "[straggler]")) {
+                strcpy(straggler, line);
+            } else if (g_str_has_prefix(line, "[failure]failures")) {
+                strcpy(failure, line);
+            } else if (g_str_has_prefix(line, "[autoscale]enabled")) {
+                strcpy(autoscale, line);
+            } else if (g_str_has_prefix(line, "[fairshare]users")) {
+                strcpy(fairshare, line);
+            } else if (g_str_has_prefix(line, "[predict]")) {
+                strcpy(predict, line);
+            }
+        }
+        if (f) {
+            fclose(f);
+        }
+        fprintf(csv, "%s,%d,%d,%d,%s,\"%s\",%d,\"%s\",\"%s\",%d,%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%d,%lf,%lf,%lf,%lf,%lf,%ld\n",
+            sc->name, sc->sched_policy, sc->clients, sc->fraction, sc->bw_file, sc->slowdown, sc->spec_percentile, sc->failures, sc->autoscale, status[i],
+            (int)get_field(result, "jobs_done"),
+            get_field(result, "makespan"),
+            get_field(result, "turnaround_mean"),
+            get_field(result, "turnaround_p95"),
+            get_field(result, "work_wait_mean"),
+            get_field(straggler, "work_exec_p99"),
+            get_field(straggler, "wasted_compute_pct"),
+            get_field(failure, "lost_compute"),
+            (int)get_field(failure, "requeued"),
+            get_field(autoscale, "client_hours"),
+            get_field(fairshare, "turnaround_jain"),
+            get_field(predict, "runtime_mape"),
+            get_field(summary, "wall_time"),
+            get_field(summary, "events_per_sec"),
+            (long)get_field(summary, "peak_rss_kb"));
+        printf("%-20s %6d %7d %8d %6d %9d %12.1lf %12.1lf %12.1lf %12.1lf %9.2lf %12.0lf %10ld\n",
+            sc->name, sc->sched_policy, sc->clients, sc->fraction, status[i],
+            (int)get_field(result, "jobs_done"),
+            get_field(result, "makespan"),
+            get_field(result, "turnaround_mean"),
+            get_field(result, "turnaround_p95"),
+            get_field(result, "work_wait_mean"),
+            get_field(summary, "wall_time"),
+            get_field(summary, "events_per_sec"),
+            (long)get_field(summary, "peak_rss_kb"));
+    }
+    fclose(csv);
+    printf("[sweep]results written to %s/sweep_results.csv, per-run output in %s/<name>.out\n", sweep_dir, sweep_dir);
+}
+
+/* run the sweep given by --sweep=<file>. the parent loads the traces, forks up
+ * to --sweep-workers runs at a time and never initializes ROSS/MPI itself;
+ * it returns the exit code of the sweep. a forked run, and any process
+ * without --sweep, gets -1 back and goes on with the normal simulation.
+ * sweeps are meant to be started without mpirun */
+int sweep_main(int argc, char **argv) {
+    const char *opt = get_opt(argc, argv, "sweep");
+    if (opt == NULL || opt[0] == 0) {
+        return -1;
+    }
+    snprintf(sweep_file_name, sizeof(sweep_file_name), "%s", opt);
+    if ((opt = get_opt(argc, argv, "sweep-dir"))) {
+        snprintf(sweep_dir, sizeof(sweep_dir), "%s", opt);
+    }
+    sweep_workers = (opt = get_opt(argc, argv, "sweep-workers")) ? atoi(opt) : 0;
+    if (sweep_workers <= 0) {
+        sweep_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    const char *base_config = get_opt(argc, argv, "codes-config");
+    const char *jobtrace = get_opt(argc, argv, "jobtrace");
+    const char *worktrace = get_opt(argc, argv, "worktrace");
+    if (!base_config || !jobtrace || !worktrace) {
+        fprintf(stderr, "--sweep needs --codes-config, --jobtrace and --worktrace\n");
+        return 1;
+    }
+    /* the runs replay the traces parsed here from the start */
+    if (get_opt(argc, argv, "restart") || get_opt(argc, argv, "warm-start")) {
+        fprintf(stderr, "--restart and --warm-start cannot be combined with --sweep\n");
+        return 1;
+    }
+    if (mkdir(sweep_dir, 0755) != 0 && errno != EEXIST) {
+        perror(sweep_dir);
+        return 1;
+    }
+
+    int n = 0;
+    SweepConfig *configs = parse_sweep_file(sweep_file_name, &n);
+    printf("[sweep]%d runs, %d workers\n", n, sweep_workers);
+
+    /* parse once, the runs inherit job_map and work_map copy-on-write. the
+     * trace window and job sample apply at parse time, so take them here */
+    snprintf(jobtrace_file_name, sizeof(jobtrace_file_name), "%s", jobtrace);
+    snprintf(worktrace_file_name, sizeof(worktrace_file_name), "%s", worktrace);
+    window_start = (opt = get_opt(argc, argv, "window-start")) ? atoi(opt) : 0;
+    window_end = (opt = get_opt(argc, argv, "window-end")) ? atoi(opt) : 0;
+    job_sample_rate = (opt = get_opt(argc, argv, "job-sample")) ? atoi(opt) : 0;
+    init_awe_server();
+
+    pid_t *pids = malloc(sizeof(pid_t) * n);
+    int *status = malloc(sizeof(int) * n);
+    int next = 0;
+    int running = 0;
+    int failed = 0;
+    while (next < n || running > 0) {
+        if (next < n && running < sweep_workers) {
+            SweepConfig *sc = &configs[next];
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                char path[MAX_NAME_LENGTH_WKLD];
+                snprintf(path, sizeof(path), "%s/%s.out", sweep_dir, sc->name);
+                if (freopen(path, "w", stdout) == NULL) {
+                    perror(path);
+                    exit(1);
+                }
+                dup2(fileno(stdout), fileno(stderr));
+                snprintf(sc->output_file, MAX_NAME_LENGTH_WKLD, "%s/%s.log", sweep_dir, sc->name);
+                make_codes_config(base_config, sc);
+                child_config = sc;
+                return -1;
+            }
+            if (pid < 0) {
+                perror("fork");
+                exit(1);
+            }
+            printf("[sweep]started %s (pid %d)\n", sc->name, (int)pid);
+            pids[next++] = pid;
+            running++;
+            continue;
+        }
+        int wstatus;
+        pid_t pid = wait(&wstatus);
+        if (pid < 0) {
+            break;
+        }
+        for (int i = 0; i < next; i++) {
+            if (pids[i] == pid) {
+                status[i] = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+                failed += status[i] != 0;
+                printf("[sweep]finished %s, exit status %d\n", configs[i].name, status[i]);
+            }
+        }
+        running--;
+    }
+    report_sweep(configs, status, n);
+    free(pids);
+    free(status);
+    free(configs);
+    return failed > 0;
+}
+
+/* configuration of this run if the process was forked by a sweep, NULL otherwise */
+SweepConfig* sweep_get_config() {
+    return child_config;
+}
+
+/* the generated codes config is not needed once codes has read it */
+void sweep_config_loaded() {
+    if (child_config) {
+        unlink(child_config->codes_config);
+    }
+}
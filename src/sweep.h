@@ -0,0 +1,53 @@
+/*
+ * File:   sweep.h
+ *
+ * Parameter sweep: load the traces once, then run a list of configurations
+ * as independent simulations in forked workers. The workers share the parsed
+ * job_map/work_map copy-on-write, so every run starts from the pristine
+ * workload. Results are aggregated into one table. --window-start,
+ * --window-end and --job-sample from the command line apply to all runs;
+ * --restart and --warm-start are not supported with --sweep.
+ *
+ * A sweep file has one run per line, in the trace key=value; format:
+ *   name=rr_50;sched_policy=0;clients=50;fraction=50
+ *   name=greedy_slow;sched_policy=2;clients=50;bw_file=modelnet-simplewan-bw-slow.conf
+ * Keys not given keep their command line value. clients replaces the
+ * "#clients" placeholder of the codes config, bw_file its net_bw_mbps_file.
+ * slowdown, spec_percentile, failures and autoscale set --slowdown,
+ * --spec-percentile, --failures and --autoscale, e.g.
+ *   name=spec95;slowdown=pareto:2;spec_percentile=95
+ *   name=preempt;failures=1:7200:300
+ *   name=burst;autoscale=0:-1:-1,1:0:100
+ *
+ * Created on June 27, 2014, 9:45 AM
+ */
+
+#ifndef SWEEP_H
+#define	SWEEP_H
+
+#include "awe_types.h"
+
+typedef struct SweepConfig SweepConfig;
+struct SweepConfig {
+    char name[MAX_NAME_LENGTH_WKLD];
+    int sched_policy;   /* -1: not set */
+    int clients;        /* -1: not set */
+    int fraction;       /* -1: not set */
+    char bw_file[MAX_NAME_LENGTH_WKLD];
+    char slowdown[MAX_NAME_LENGTH_WKLD];
+    int spec_percentile;  /* -1: not set */
+    char failures[MAX_NAME_LENGTH_WKLD];
+    char autoscale[MAX_NAME_LENGTH_WKLD];
+    char codes_config[MAX_NAME_LENGTH_WKLD];  /* generated config of this run */
+    char output_file[MAX_NAME_LENGTH_WKLD];   /* event log of this run */
+};
+
+extern char sweep_file_name[256];
+extern int sweep_workers;  //concurrent runs, 0: one per cpu
+extern char sweep_dir[256];  //per-run output and the result table
+
+int sweep_main(int argc, char **argv);
+SweepConfig* sweep_get_config();
+void sweep_config_loaded();
+
+#endif	/* SWEEP_H */
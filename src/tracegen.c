@@ -0,0 +1,434 @@
+/*
+ * tracegen: synthetic workload generator for awesim
+ *
+ * Emits a job trace and a workunit trace in the key=value; format read by
+ * parse_jobtrace() and parse_worktrace(). All randomness comes from one seeded
+ * generator, so the same options and seed always give the same traces.
+ *
+ * Distributions are given as name:param[:param]:
+ *   const:V  uniform:MIN:MAX  exp:MEAN  normal:MEAN:SD  lognormal:MU:SIGMA
+ *   pareto:XM:ALPHA
+ * Per-stage settings override the defaults, e.g. --stage-splits 3=uniform:10:50
+ *
+ * Example, ~1M workunits:
+ *   ./tracegen --jobs 20000 --splits uniform:20:80 --seed 7 \
+ *       --jobtrace gen.jobs --worktrace gen.works
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+
+#define MAX_NUM_TASKS 30  /* same as awe_types.h */
+#define Mega (1024*1024)
+
+/* ---- random numbers: splitmix64, identical on every platform ---- */
+
+static uint64_t rng_state = 1;
+
+static uint64_t rng_next() {
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* uniform in (0, 1) */
+static double rng_uniform() {
+    return ((rng_next() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* the draws are separate statements: the evaluation order of operands is
+ * unspecified, and the trace must not depend on the compiler */
+static double rng_normal() {
+    double u1 = rng_uniform();
+    double u2 = rng_uniform();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* ---- distributions ---- */
+
+enum dist_type { DIST_CONST, DIST_UNIFORM, DIST_EXP, DIST_NORMAL, DIST_LOGNORMAL, DIST_PARETO };
+
+typedef struct Dist Dist;
+struct Dist {
+    enum dist_type type;
+    double a;
+    double b;
+};
+
+static int parse_dist(const char *spec, Dist *d) {
+    char name[32];
+    d->a = d->b = 0;
+    int n = sscanf(spec, "%31[a-z]:%lf:%lf", name, &d->a, &d->b);
+    if (n < 2) {
+        return -1;
+    }
+    if (strcmp(name, "const") == 0) {
+        d->type = DIST_CONST;
+    } else if (strcmp(name, "uniform") == 0 && n == 3) {
+        d->type = DIST_UNIFORM;
+    } else if (strcmp(name, "exp") == 0) {
+        d->type = DIST_EXP;
+    } else if (strcmp(name, "normal") == 0 && n == 3) {
+        d->type = DIST_NORMAL;
+    } else if (strcmp(name, "lognormal") == 0 && n == 3) {
+        d->type = DIST_LOGNORMAL;
+    } else if (strcmp(name, "pareto") == 0 && n == 3) {
+        d->type = DIST_PARETO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static double sample(Dist *d) {
+    switch (d->type) {
+        case DIST_CONST:
+            return d->a;
+        case DIST_UNIFORM:
+            return d->a + (d->b - d->a) * rng_uniform();
+        case DIST_EXP:
+            return -d->a * log(rng_uniform());
+        case DIST_NORMAL:
+            return d->a + d->b * rng_normal();
+        case DIST_LOGNORMAL:
+            return exp(d->a + d->b * rng_normal());
+        case DIST_PARETO:
+            return d->a / pow(rng_uniform(), 1.0 / d->b);
+    }
+    return 0;
+}
+
+/* at least min: the parsers drop jobs with 0-sized data and tasks without workunits */
+static uint64_t sample_int(Dist *d, uint64_t min) {
+    double v = floor(sample(d) + 0.5);
+    return v < min ? min : (uint64_t)v;
+}
+
+/* ---- options ---- */
+
+static int num_jobs = 100;
+static int num_tasks = 10;
+static uint64_t seed = 1;
+static long start_time = 1400000000;  /* epoch time of the first arrival */
+static char arrival[64] = "poisson:60";  /* poisson:JOBS_PER_HOUR, uniform:SEC, burst:SIZE:SEC */
+static char dag[64] = "mgrast";  /* mgrast, chain, forkjoin, random:EDGE_PROB */
+static double nominal_bw = 10;  /* MB/s, for the observed time_data_in/out fields */
+static int num_users = 0;  /* 0: jobs without user and project */
+static double user_skew = 1.0;  /* zipf exponent of the jobs per user */
+static int num_projects = 1;
+static char jobtrace[256] = "synthetic.jobs";
+static char worktrace[256] = "synthetic.works";
+
+static Dist job_input;  /* bytes */
+static Dist splits[MAX_NUM_TASKS];
+static Dist runtime[MAX_NUM_TASKS];  /* sec per workunit */
+static Dist out_ratio[MAX_NUM_TASKS];  /* task output size / task input size */
+static Dist predata[MAX_NUM_TASKS];  /* bytes, drawn once per stage command */
+
+static int task_parents[MAX_NUM_TASKS];  /* bitmask of upstream tasks */
+
+/* same dependencies as task_dep_mgrast in util.c */
+static const int mgrast_parents[10] = {0, 1<<0, 1<<1, 1<<2, 1<<3, 1<<4, 1<<0, 1<<6, 1<<7, (1<<5)|(1<<8)};
+
+static void build_dag() {
+    memset(task_parents, 0, sizeof(task_parents));
+    double p = 0;
+    if (strcmp(dag, "mgrast") == 0) {
+        if (num_tasks != 10) {
+            fprintf(stderr, "--dag mgrast needs --tasks 10\n");
+            exit(1);
+        }
+        memcpy(task_parents, mgrast_parents, sizeof(mgrast_parents));
+    } else if (strcmp(dag, "chain") == 0) {
+        for (int i = 1; i < num_tasks; i++) {
+            task_parents[i] = 1 << (i - 1);
+        }
+    } else if (strcmp(dag, "forkjoin") == 0) {
+        for (int i = 1; i < num_tasks - 1; i++) {
+            task_parents[i] = 1;
+        }
+        if (num_tasks > 2) {
+            task_parents[num_tasks - 1] = ((1 << (num_tasks - 1)) - 1) & ~1;
+        } else if (num_tasks == 2) {
+            task_parents[1] = 1;
+        }
+    } else if (sscanf(dag, "random:%lf", &p) == 1) {
+        /* edges only go to later tasks, so the graph is acyclic; every task
+         * but the first gets at least one parent, so the job has one root */
+        for (int i = 1; i < num_tasks; i++) {
+            for (int j = 0; j < i; j++) {
+                if (rng_uniform() < p) {
+                    task_parents[i] |= 1 << j;
+                }
+            }
+            if (task_parents[i] == 0) {
+                task_parents[i] = 1 << (rng_next() % i);
+            }
+        }
+    } else {
+        fprintf(stderr, "unknown dag %s\n", dag);
+        exit(1);
+    }
+}
+
+static double next_arrival(double t, int job_idx) {
+    double a, b;
+    if (sscanf(arrival, "poisson:%lf", &a) == 1) {
+        return t - 3600.0 / a * log(rng_uniform());
+    } else if (sscanf(arrival, "uniform:%lf", &a) == 1) {
+        return t + a;
+    } else if (sscanf(arrival, "burst:%lf:%lf", &a, &b) == 2) {
+        return (job_idx % (int)a == 0) ? t + b : t;
+    }
+    fprintf(stderr, "unknown arrival process %s\n", arrival);
+    exit(1);
+}
+
+static void dist_arg(const char *spec, Dist *d, int count) {
+    Dist v;
+    if (parse_dist(spec, &v) < 0) {
+        fprintf(stderr, "bad distribution %s\n", spec);
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        d[i] = v;
+    }
+}
+
+/* STAGE=SPEC */
+static void stage_dist_arg(const char *arg, Dist *d) {
+    char *eq = strchr(arg, '=');
+    int stage = atoi(arg);
+    if (!eq || stage < 0 || stage >= MAX_NUM_TASKS) {
+        fprintf(stderr, "bad per-stage distribution %s\n", arg);
+        exit(1);
+    }
+    dist_arg(eq + 1, &d[stage], 1);
+}
+
+static void usage(const char *prog) {
+    printf("usage: %s [options]\n"
+        "  --jobs N                 number of jobs (100)\n"
+        "  --tasks N                tasks per job (10)\n"
+        "  --seed N                 random seed (1)\n"
+        "  --start EPOCH            arrival time of the first job (1400000000)\n"
+        "  --arrival SPEC           poisson:JOBS_PER_HOUR | uniform:SEC | burst:SIZE:SEC (poisson:60)\n"
+        "  --dag SPEC               mgrast | chain | forkjoin | random:EDGE_PROB (mgrast)\n"
+        "  --input DIST             job input size in bytes (lognormal:21:1.5)\n"
+        "  --splits DIST            workunits per task (const:1)\n"
+        "  --runtime DIST           workunit runtime in sec (lognormal:5:1)\n"
+        "  --out-ratio DIST         task output size / task input size (uniform:0.5:1)\n"
+        "  --predata DIST           per-stage prerequisite data in bytes (const:0)\n"
+        "  --stage-splits S=DIST    override for stage S, likewise --stage-runtime,\n"
+        "  --stage-out-ratio S=DIST --stage-out-ratio and --stage-predata\n"
+        "  --nominal-bw MB/s        bandwidth for the observed transfer times (10)\n"
+        "  --users N                submitting users, user i gets jobs ~ 1/i^SKEW (0: no users)\n"
+        "  --user-skew SKEW         (1.0)\n"
+        "  --projects N             users are spread round-robin over N projects (1)\n"
+        "  --jobtrace FILE          (synthetic.jobs)\n"
+        "  --worktrace FILE         (synthetic.works)\n",
+        prog);
+}
+
+int main(int argc, char **argv) {
+    dist_arg("lognormal:21:1.5", &job_input, 1);
+    dist_arg("const:1", splits, MAX_NUM_TASKS);
+    dist_arg("lognormal:5:1", runtime, MAX_NUM_TASKS);
+    dist_arg("uniform:0.5:1", out_ratio, MAX_NUM_TASKS);
+    dist_arg("const:0", predata, MAX_NUM_TASKS);
+
+    static struct option opts[] = {
+        {"jobs", required_argument, 0, 'j'},
+        {"tasks", required_argument, 0, 't'},
+        {"seed", required_argument, 0, 's'},
+        {"start", required_argument, 0, 'T'},
+        {"arrival", required_argument, 0, 'a'},
+        {"dag", required_argument, 0, 'd'},
+        {"input", required_argument, 0, 'i'},
+        {"splits", required_argument, 0, 'p'},
+        {"runtime", required_argument, 0, 'r'},
+        {"out-ratio", required_argument, 0, 'o'},
+        {"predata", required_argument, 0, 'P'},
+        {"stage-splits", required_argument, 0, 1},
+        {"stage-runtime", required_argument, 0, 2},
+        {"stage-out-ratio", required_argument, 0, 3},
+        {"stage-predata", required_argument, 0, 4},
+        {"nominal-bw", required_argument, 0, 'b'},
+        {"users", required_argument, 0, 'u'},
+        {"user-skew", required_argument, 0, 'k'},
+        {"projects", required_argument, 0, 'q'},
+        {"jobtrace", required_argument, 0, 'J'},
+        {"worktrace", required_argument, 0, 'W'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    /* defaults first so that per-stage overrides win regardless of order */
+    for (int pass = 0; pass < 2; pass++) {
+        int c;
+        optind = 1;
+        while ((c = getopt_long(argc, argv, "", opts, NULL)) != -1) {
+            int is_stage = (c >= 1 && c <= 4);
+            if (pass == 0 && is_stage) {
+                continue;
+            }
+            if (pass == 1 && !is_stage) {
+                continue;
+            }
+            switch (c) {
+                case 'j': num_jobs = atoi(optarg); break;
+                case 't': num_tasks = atoi(optarg); break;
+                case 's': seed = strtoull(optarg, NULL, 10); break;
+                case 'T': start_time = atol(optarg); break;
+                case 'a': snprintf(arrival, sizeof(arrival), "%s", optarg); break;
+                case 'd': snprintf(dag, sizeof(dag), "%s", optarg); break;
+                case 'i': dist_arg(optarg, &job_input, 1); break;
+                case 'p': dist_arg(optarg, splits, MAX_NUM_TASKS); break;
+                case 'r': dist_arg(optarg, runtime, MAX_NUM_TASKS); break;
+                case 'o': dist_arg(optarg, out_ratio, MAX_NUM_TASKS); break;
+                case 'P': dist_arg(optarg, predata, MAX_NUM_TASKS); break;
+                case 1: stage_dist_arg(optarg, splits); break;
+                case 2: stage_dist_arg(optarg, runtime); break;
+                case 3: stage_dist_arg(optarg, out_ratio); break;
+                case 4: stage_dist_arg(optarg, predata); break;
+                case 'b': nominal_bw = atof(optarg); break;
+                case 'u': num_users = atoi(optarg); break;
+                case 'k': user_skew = atof(optarg); break;
+                case 'q': num_projects = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+                case 'J': snprintf(jobtrace, sizeof(jobtrace), "%s", optarg); break;
+                case 'W': snprintf(worktrace, sizeof(worktrace), "%s", optarg); break;
+                case 'h': usage(argv[0]); return 0;
+                default: usage(argv[0]); return 1;
+            }
+        }
+    }
+    if (num_tasks < 1 || num_tasks > MAX_NUM_TASKS) {
+        fprintf(stderr, "--tasks must be within 1..%d\n", MAX_NUM_TASKS);
+        return 1;
+    }
+    double arrival_a, arrival_b;
+    if ((sscanf(arrival, "poisson:%lf", &arrival_a) == 1 && arrival_a <= 0)
+            || (sscanf(arrival, "burst:%lf:%lf", &arrival_a, &arrival_b) == 2 && arrival_a < 1)) {
+        fprintf(stderr, "--arrival %s: the rate must be > 0 and the burst size >= 1\n", arrival);
+        return 1;
+    }
+
+    rng_state = seed;
+    build_dag();
+
+    /* one shared prerequisite object per stage command, like a reference database */
+    uint64_t predata_size[MAX_NUM_TASKS];
+    for (int i = 0; i < num_tasks; i++) {
+        predata_size[i] = sample_int(&predata[i], 0);
+    }
+
+    FILE *fj = fopen(jobtrace, "w");
+    FILE *fw = fopen(worktrace, "w");
+    if (!fj || !fw) {
+        perror("tracegen");
+        return 1;
+    }
+
+    char deps[MAX_NUM_TASKS * 64];
+    int len = 0;
+    deps[0] = 0;
+    for (int i = 0; i < num_tasks; i++) {
+        if (task_parents[i] == 0) {
+            continue;
+        }
+        len += sprintf(deps + len, "%s%d:", len ? "," : "", i);
+        int first = 1;
+        for (int j = 0; j < num_tasks; j++) {
+            if (task_parents[i] & (1 << j)) {
+                len += sprintf(deps + len, "%s%d", first ? "" : "+", j);
+                first = 0;
+            }
+        }
+    }
+
+    /* cumulative zipf weights of the users */
+    double *user_cdf = NULL;
+    if (num_users > 0) {
+        user_cdf = malloc(sizeof(double) * num_users);
+        double sum = 0;
+        for (int u = 0; u < num_users; u++) {
+            sum += 1.0 / pow(u + 1, user_skew);
+            user_cdf[u] = sum;
+        }
+        for (int u = 0; u < num_users; u++) {
+            user_cdf[u] /= sum;
+        }
+    }
+
+    double t = start_time;
+    uint64_t num_works = 0;
+    for (int jb = 0; jb < num_jobs; jb++) {
+        if (jb > 0) {
+            t = next_arrival(t, jb);
+        }
+        char jobid[32];
+        sprintf(jobid, "gen%08d", jb);  /* workids longer than 10 chars, like AWE uuids */
+        uint64_t inputsize = sample_int(&job_input, 1);
+        fprintf(fj, "jobid=%s;queued=%ld;num_tasks=%d;inputsize=%llu;deps=%s",
+            jobid, (long)t, num_tasks, (unsigned long long)inputsize, deps);
+        if (num_users > 0) {
+            double r = rng_uniform();
+            int u = 0;
+            while (u < num_users - 1 && user_cdf[u] < r) {
+                u++;
+            }
+            fprintf(fj, ";user=user%d;project=project%d", u, u % num_projects);
+        }
+        fprintf(fj, "\n");
+
+        /* tasks in index order: parents always have lower indices */
+        uint64_t task_out[MAX_NUM_TASKS];
+        for (int i = 0; i < num_tasks; i++) {
+            uint64_t task_in = 0;
+            if (task_parents[i] == 0) {
+                task_in = inputsize;
+            } else {
+                for (int j = 0; j < i; j++) {
+                    if (task_parents[i] & (1 << j)) {
+                        task_in += task_out[j];
+                    }
+                }
+            }
+            int n = (int)sample_int(&splits[i], 1);
+            /* ranks as expected by parse_ready_tasks: 0 if unsplit, 1..n otherwise */
+            int first_rank = (n == 1) ? 0 : 1;
+            task_out[i] = 0;
+            for (int r = first_rank; r < first_rank + n; r++) {
+                uint64_t size_in = task_in / n > 0 ? task_in / n : 1;
+                uint64_t size_out = (uint64_t)(size_in * sample(&out_ratio[i]));
+                if (size_out == 0) {
+                    size_out = 1;
+                }
+                task_out[i] += size_out;
+                fprintf(fw, "workid=%s_%d_%d;cmd=stage%d;runtime=%llu;size_infile=%llu;size_outfile=%llu;time_data_in=%.3lf;time_data_out=%.3lf",
+                    jobid, i, r, i,
+                    (unsigned long long)sample_int(&runtime[i], 1),
+                    (unsigned long long)size_in,
+                    (unsigned long long)size_out,
+                    size_in / (nominal_bw * Mega),
+                    size_out / (nominal_bw * Mega));
+                if (predata_size[i] > 0) {
+                    fprintf(fw, ";size_predata=%llu;time_predata_in=%.3lf",
+                        (unsigned long long)predata_size[i],
+                        predata_size[i] / (nominal_bw * Mega));
+                }
+                fprintf(fw, "\n");
+                num_works += 1;
+            }
+        }
+    }
+    fclose(fj);
+    fclose(fw);
+    printf("[tracegen]seed=%llu, jobs=%d, workunits=%llu, span=%.0lf sec, jobtrace=%s, worktrace=%s\n",
+        (unsigned long long)seed, num_jobs, (unsigned long long)num_works, t - start_time, jobtrace, worktrace);
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <string.h>
+#include <assert.h>
+
+#include "transfer.h"
+#include "util.h"
+#include "sampler.h"
+
+#include "codes/model-net.h"
+
+int chunk_size = 0;
+int num_streams = 1;
+
+/* chunked transfer id -> number of chunks received so far */
+static GHashTable *reassembly = NULL;
+static uint64_t next_xfer_id = 1;
+
+/* statistics */
+static uint64_t num_transfers = 0;
+static uint64_t num_chunked_transfers = 0;
+static uint64_t num_chunks_sent = 0;
+
+static int get_num_streams() {
+    return num_streams > 0 ? num_streams : 1;
+}
+
+static const char* get_category(enum awe_event_type event_type) {
+    return (event_type == UPLOAD_REQ || event_type == UPLOAD_ACK) ? "upload" : "download";
+}
+
+static uint64_t get_chunk_bytes(uint64_t size, int chunk_idx) {
+    uint64_t chunk_bytes = (uint64_t)chunk_size * Mega;
+    uint64_t offset = chunk_idx * chunk_bytes;
+    return (size - offset < chunk_bytes) ? size - offset : chunk_bytes;
+}
+
+/* send chunk m->chunk_idx of the transfer described by m; the self event
+ * fires once the chunk left the sender and starts the next chunk of the stream */
+static void send_chunk(tw_lp *lp, tw_lpid dest_id, awe_msg *remote) {
+    awe_msg m_self = *remote;
+    m_self.event_type = CHUNK_SENT;
+    m_self.chunk_event_type = remote->event_type;
+    m_self.chunk_dest = dest_id;
+    uint64_t chunk_bytes = get_chunk_bytes(remote->size, remote->chunk_idx);
+    model_net_event(net_id, get_category(remote->event_type), dest_id, chunk_bytes, 0.0,
+            sizeof(awe_msg), (const void*)remote, sizeof(awe_msg), (const void*)&m_self, lp);
+    sampler_link_bytes(lp->gid, dest_id, chunk_bytes);
+    num_chunks_sent += 1;
+}
+
+/* send remote->size bytes to dest_id, the receiver gets remote as event
+ * once the whole object arrived (see transfer_recv) */
+void transfer_send(tw_lp *lp, tw_lpid dest_id, awe_msg *remote) {
+    num_transfers += 1;
+    uint64_t chunk_bytes = (uint64_t)chunk_size * Mega;
+    if (chunk_bytes == 0 || remote->size <= chunk_bytes) {
+        remote->xfer_id = 0;
+        remote->chunk_idx = 0;
+        remote->num_chunks = 1;
+        model_net_event(net_id, get_category(remote->event_type), dest_id, remote->size, 0.0,
+                sizeof(awe_msg), (const void*)remote, 0, NULL, lp);
+        sampler_link_bytes(lp->gid, dest_id, remote->size);
+        return;
+    }
+    num_chunked_transfers += 1;
+    remote->xfer_id = next_xfer_id++;
+    remote->num_chunks = (remote->size + chunk_bytes - 1) / chunk_bytes;
+    /* stream s carries chunks s, s+K, s+2K, ... */
+    for (int s = 0; s < get_num_streams() && s < remote->num_chunks; s++) {
+        remote->chunk_idx = s;
+        send_chunk(lp, dest_id, remote);
+    }
+}
+
+/* handle CHUNK_SENT: continue the stream with its next chunk */
+void transfer_chunk_sent(tw_lp *lp, awe_msg *m) {
+    int next_idx = m->chunk_idx + get_num_streams();
+    if (next_idx >= m->num_chunks) {
+        return;
+    }
+    awe_msg remote = *m;
+    remote.event_type = m->chunk_event_type;
+    remote.chunk_idx = next_idx;
+    send_chunk(lp, m->chunk_dest, &remote);
+}
+
+/* account for a received transfer message, return 1 once the whole object
+ * arrived and the event should be handled, 0 for intermediate chunks */
+int transfer_recv(tw_lp *lp, awe_msg *m) {
+    if (m->xfer_id == 0 || m->num_chunks <= 1) {
+        sampler_link_bytes(m->src, lp->gid, -(int64_t)m->size);
+        return 1;
+    }
+    sampler_link_bytes(m->src, lp->gid, -(int64_t)get_chunk_bytes(m->size, m->chunk_idx));
+    if (!reassembly) {
+        reassembly = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    gpointer key = GSIZE_TO_POINTER(m->xfer_id);
+    int received = GPOINTER_TO_INT(g_hash_table_lookup(reassembly, key)) + 1;
+    if (received < m->num_chunks) {
+        g_hash_table_insert(reassembly, key, GINT_TO_POINTER(received));
+        return 0;
+    }
+    g_hash_table_remove(reassembly, key);
+    return 1;
+}
+
+void transfer_report_stats() {
+    printf("[transfer]chunk_size=%d MB, num_streams=%d, transfers=%llu, chunked_transfers=%llu, chunks_sent=%llu, chunk_events=%llu\n",
+        chunk_size,
+        num_streams,
+        (unsigned long long)num_transfers,
+        (unsigned long long)num_chunked_transfers,
+        (unsigned long long)num_chunks_sent,
+        (unsigned long long)(2 * num_chunks_sent));
+}
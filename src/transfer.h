@@ -0,0 +1,26 @@
+/*
+ * File:   transfer.h
+ *
+ * Data transfers between clients, shock_routers and Shock. An object is sent
+ * either as one model-net message or, when chunking is enabled, split into
+ * chunks sent over parallel streams and reassembled at the receiver.
+ *
+ * Created on June 10, 2014, 4:12 PM
+ */
+
+#ifndef TRANSFER_H
+#define	TRANSFER_H
+
+#include "glib.h"
+#include "ross.h"
+#include "awe_types.h"
+
+extern int chunk_size;   //chunk size in MB, 0: send objects as a whole
+extern int num_streams;  //number of parallel streams per chunked transfer
+
+void transfer_send(tw_lp *lp, tw_lpid dest_id, awe_msg *remote);
+int transfer_recv(tw_lp *lp, awe_msg *m);
+void transfer_chunk_sent(tw_lp *lp, awe_msg *m);
+void transfer_report_stats();
+
+#endif	/* TRANSFER_H */
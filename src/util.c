@@ -1,13 +1,37 @@
 #include <stdlib.h>	/* exit, malloc, realloc, free */
 #include <stdio.h>	/* fopen, fgetc, fputs, fwrite */
 #include <string.h>
+#include <assert.h>
 
 #include "util.h"
+#include "arena.h"
+#include "work_table.h"
+#include "codes/codes_mapping.h"
+#include "codes/configuration.h"
 
 int net_id = 0;
 FILE *event_log = NULL;
 
 float fraction = 1.0;
+int sim_finished = 0;
+
+/* trace window and job sampling, applied while parsing */
+int window_start = 0;     /* epoch time, 0: from the first job */
+int window_end = 0;       /* epoch time, 0: up to the last job */
+int job_sample_rate = 0;  /* percent of jobs simulated, 0: all */
+static int num_skipped_jobs = 0;
+static int num_skipped_works = 0;
+static GHashTable *dropped_jobs = NULL;  /* ids of jobs removed for 0-size data */
+static int num_dropped_works = 0;
+
+/* parsed jobs and workunits live until the end of the run, so they are
+   parsed into a scratch record and only accepted ones are copied here */
+#define TRACE_ARENA_BLOCK (16 << 20)
+static Arena *trace_arena = NULL;
+static Workunit scratch_work;
+static WorkStat scratch_stats;
+static DataObj scratch_predata[MAX_IO_FILE_NUM];
+static Job scratch_job;
 
 static Workunit* parse_workunit_by_trace(gchar * line);
 static Job* parse_job_by_trace(gchar *line);
@@ -30,6 +54,9 @@ const char* ready_string = "0000000000";
 /*serve as MAX epoch time, Sat, 20 Nov 2286 17:46:39 GMT*/
 double kickoff_epoch_time = 9999999999; 
 
+/* sim time in sec at which this run started, non-zero when restarted from a checkpoint */
+double sim_offset = 0;
+
 /* convert ns to seconds */
 tw_stime ns_to_s(tw_stime ns)
 {
@@ -42,26 +69,112 @@ tw_stime s_to_ns(tw_stime ns)
     return(ns * (1000.0 * 1000.0 * 1000.0));
 }
 
+/* client sites are the LP groups named AWE_CLIENT_SITE_*, indexed in config order */
+static int num_sites = -1;
+static char site_names[MAX_NUM_SITES][MAX_NAME_LENGTH_WKLD];
+static int *site_of_group = NULL; /* lp group index -> site index or -1 */
+static GHashTable *group_of_lp = NULL; /* lp id -> lp group index + 1 */
+
+static void init_sites() {
+    num_sites = 0;
+    site_of_group = malloc(sizeof(int) * lpconf.lpgroups_count);
+    for (int i = 0; i < lpconf.lpgroups_count; i++) {
+        site_of_group[i] = -1;
+        if (g_str_has_prefix(lpconf.lpgroups[i].name, CLIENT_SITE_PREFIX)) {
+            assert(num_sites < MAX_NUM_SITES);
+            site_of_group[i] = num_sites;
+            strcpy(site_names[num_sites++], lpconf.lpgroups[i].name);
+        }
+    }
+}
+
+int lp_group_exists(const char* group_name) {
+    for (int i = 0; i < lpconf.lpgroups_count; i++) {
+        if (strcmp(lpconf.lpgroups[i].name, group_name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* index in the LPGROUPS config of the group an lp belongs to */
+int get_lp_group_idx(tw_lpid lp_id) {
+    if (!group_of_lp) {
+        group_of_lp = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    gpointer grp = g_hash_table_lookup(group_of_lp, GSIZE_TO_POINTER(lp_id));
+    if (grp) {
+        return GPOINTER_TO_INT(grp) - 1;
+    }
+    char grp_name[MAX_NAME_LENGTH_WKLD];
+    char lp_type_name[MAX_NAME_LENGTH_WKLD];
+    char annotation[MAX_NAME_LENGTH_WKLD];
+    int grp_id, lp_type_id, grp_rep_id, offset;
+    codes_mapping_get_lp_info(lp_id, grp_name, &grp_id, lp_type_name, &lp_type_id, annotation, &grp_rep_id, &offset);
+    int grp_idx = -1;
+    for (int i = 0; i < lpconf.lpgroups_count; i++) {
+        if (strcmp(lpconf.lpgroups[i].name, grp_name) == 0) {
+            grp_idx = i;
+            break;
+        }
+    }
+    assert(grp_idx >= 0);
+    g_hash_table_insert(group_of_lp, GSIZE_TO_POINTER(lp_id), GINT_TO_POINTER(grp_idx + 1));
+    return grp_idx;
+}
+
+int get_num_sites() {
+    if (num_sites < 0) {
+        init_sites();
+    }
+    return num_sites;
+}
+
+const char* get_site_name(int site) {
+    if (num_sites < 0) {
+        init_sites();
+    }
+    assert(site >= 0 && site < num_sites);
+    return site_names[site];
+}
+
+/* site index of the group an lp belongs to, -1 if not in a client site */
+int get_site_id(tw_lpid lp_id) {
+    if (num_sites < 0) {
+        init_sites();
+    }
+    return site_of_group[get_lp_group_idx(lp_id)];
+}
+
+/* stop the run once the workload is done instead of running to the one-year
+ * g_tw_ts_end. codes_event_new asserts on events past the new end time, so
+ * every handler that schedules more events checks sim_finished and stops */
+void end_simulation(tw_lp *lp) {
+    sim_finished = 1;
+    g_tw_ts_end = tw_now(lp) + ns_tw_lookahead;
+}
+
 /*convert eporch time to simulation time*/
 tw_stime etime_to_stime(double etime) {
     return etime - kickoff_epoch_time;
 }
 
 
-static void free_key(gpointer data) {
-	//not used for now (key is part of the data thus can be freed with the data)
-}
-
-static void free_value(gpointer data) {
-	free(data);
+static void* trace_arena_copy(void* record, size_t size) {
+    if (!trace_arena) {
+        trace_arena = arena_new(TRACE_ARENA_BLOCK);
+    }
+    void *p = arena_alloc(trace_arena, size);
+    memcpy(p, record, size);
+    return p;
 }
 
 void print_workunit(Workunit* work) {
     printf("workid=%s;cmd=%s;queued=%f;runtime=%f;\n", 
         work->id, 
         work->cmd, 
-        work->stats.st_created,
-        work->stats.runtime
+        work_runs[work->idx].st_created,
+        work_params.runtime[work->idx]
     );
 }
 
@@ -96,6 +209,66 @@ void display_hash_table(GHashTable *table, char* name)
     g_hash_table_foreach(table, print_key_value, name);
 }
 
+/* name of the data object a workunit reads as input: its split of the job
+ * input for the first task, otherwise the outputs of the upstream tasks.
+ * workunits of different tasks reading the same upstream output share the
+ * same name */
+void get_input_object_id(Workunit* work, char* obj_id) {
+    int parents = get_job(work->job_idx)->task_parents[work->stage];
+    if (parents == 0) {
+        sprintf(obj_id, "%s_input_%d", work->jobid, work->rank);
+    } else {
+        sprintf(obj_id, "%s_out%x_%d", work->jobid, parents, work->rank);
+    }
+}
+
+/* parse predata list "name1:size1,name2:size2" into work->Predata */
+static void parse_predata(Workunit* work, char* val) {
+    gchar **objs = g_strsplit(val, ",", MAX_IO_FILE_NUM);
+    for (int i = 0; objs[i] && work->num_predata < MAX_IO_FILE_NUM; i++) {
+        gchar **obj = g_strsplit(objs[i], ":", 2);
+        if (obj[0] && obj[1] && strlen(obj[0]) > 0) {
+            DataObj *data = &work->Predata[work->num_predata++];
+            memset(data, 0, sizeof(DataObj));
+            strncpy(data->name, obj[0], MAX_NAME_LENGTH_WKLD - 1);
+            data->size = strtoll(obj[1], NULL, 10);
+        }
+        g_strfreev(obj);
+    }
+    g_strfreev(objs);
+}
+
+/* FNV-1a, independent of the g_str_hash used to place jobs on servers */
+static uint32_t hash_job_id(const char* id) {
+    uint32_t h = 2166136261u;
+    for (; *id; id++) {
+        h = (h ^ (unsigned char)*id) * 16777619u;
+    }
+    return h;
+}
+
+/* whether a job falls into the trace window and the deterministic sample */
+static int job_selected(Job* jb) {
+    if (window_start > 0 && jb->stats.created < window_start) {
+        return 0;
+    }
+    if (window_end > 0 && jb->stats.created >= window_end) {
+        return 0;
+    }
+    if (job_sample_rate > 0 && job_sample_rate < 100 && hash_job_id(jb->id) % 10000 >= (uint32_t)job_sample_rate * 100) {
+        return 0;
+    }
+    return 1;
+}
+
+/* share of the configured clients to run with, matching the job sample */
+double get_client_scale() {
+    if (job_sample_rate > 0 && job_sample_rate < 100) {
+        return job_sample_rate / 100.0;
+    }
+    return 1.0;
+}
+
 GHashTable* parse_worktrace(char* workload_path) {
     FILE *f;
     char line[MAX_LEN_TRACE_LINE];
@@ -106,7 +279,7 @@ GHashTable* parse_worktrace(char* workload_path) {
     }
     
     GHashTable *work_map = NULL;
-    work_map =  g_hash_table_new_full(g_str_hash, g_str_equal, free_key, free_value);
+    work_map =  g_hash_table_new(g_str_hash, g_str_equal);
     printf("[awe_server]parsing work trace, removing some invalid jobs lacking data (e.g. workunit input/output size=0) ...\n");
     
     while ( fgets ( line, sizeof(line), f ) != NULL ){ /* read a line */
@@ -114,11 +287,24 @@ GHashTable* parse_worktrace(char* workload_path) {
         work = parse_workunit_by_trace((gchar*)line);
         memset(line, 0, sizeof(line));
         if (work) {
+            work = trace_arena_copy(work, sizeof(Workunit));
+            work->Predata = trace_arena_copy(work->Predata, sizeof(DataObj) * work->num_predata);
+            work_table_add_work(work, &scratch_stats);
         	g_hash_table_insert(work_map, work->id, work);
         }
     }
+    fclose(f);
     
     printf("[awe_server]parsing work trace ... done: %u workunit parsed\n", g_hash_table_size(work_map));
+    if (num_skipped_works > 0) {
+        printf("[awe_server]%d workunits of jobs outside the window or sample skipped\n", num_skipped_works);
+    }
+    if (num_dropped_works > 0) {
+        printf("[awe_server]%d workunits of %u jobs with 0-size data skipped\n", num_dropped_works, g_hash_table_size(dropped_jobs));
+    }
+    if (trace_arena) {
+        printf("[awe_server]trace data: %.1f MB\n", trace_arena->bytes_used / (1024.0 * 1024.0));
+    }
     
     return work_map;
 }
@@ -133,12 +319,15 @@ static void increment_task_splits(GHashTable *job_map, char* work_id) {
     	job->task_splits[task_id] += 1;
         job->task_remainwork[task_id] += 1;
     }
+    g_strfreev(parts);
 }
 
 Workunit* parse_workunit_by_trace(gchar* line) {
-    Workunit* work=NULL;
-    work = malloc(sizeof(Workunit));
+    Workunit* work = &scratch_work;
+    WorkStat* stats = &scratch_stats;
     memset(work, 0, sizeof(Workunit));
+    memset(stats, 0, sizeof(WorkStat));
+    work->Predata = scratch_predata;
     gchar ** parts = NULL;
     g_strstrip(line);
     parts = g_strsplit(line, ";", 30);
@@ -157,18 +346,54 @@ Workunit* parse_workunit_by_trace(gchar* line) {
              strcpy(work->jobid, seg[0]);
              work->stage = atoi(seg[1]);
              work->rank = atoi(seg[2]);
+             g_strfreev(seg);
+             /* job not selected or unknown: skip the rest of the record */
+             Job* job = g_hash_table_lookup(job_map, work->jobid);
+             if (!job) {
+                 if (dropped_jobs && g_hash_table_lookup(dropped_jobs, work->jobid)) {
+                     num_dropped_works += 1;
+                 } else {
+                     num_skipped_works += 1;
+                 }
+                 g_strfreev(pair);
+                 g_strfreev(parts);
+                 return NULL;
+             }
+             work->job_idx = job->idx;
         } else if (strcmp(key, "cmd")==0) {
             strcpy(work->cmd, val);
         } else if (strcmp(key, "runtime")==0) {
-            work->stats.runtime = atoi(val);
+            stats->runtime = atoi(val);
         } else if (strcmp(key, "size_infile")==0) {
-            work->stats.size_infile = strtoll(val, &endptr, 10);
+            stats->size_infile = strtoll(val, &endptr, 10);
         } else if (strcmp(key, "size_outfile")==0) {
-            work->stats.size_outfile = strtoll(val, &endptr, 10);
+            stats->size_outfile = strtoll(val, &endptr, 10);
         } else if (strcmp(key, "time_data_in")==0) {
-            work->stats.time_data_in =atof(val);
+            stats->time_data_in =atof(val);
         } else if (strcmp(key, "time_data_out")==0){
-            work->stats.time_data_out = atof(val);
+            stats->time_data_out = atof(val);
+        } else if (strcmp(key, "size_predata")==0) {
+            stats->size_predata = strtoll(val, &endptr, 10);
+        } else if (strcmp(key, "time_predata_in")==0) {
+            stats->time_predata_in = atof(val);
+        } else if (strcmp(key, "predata")==0) {
+            parse_predata(work, val);
+        } else if (strcmp(key, "mem_mb")==0) {
+            work->mem_mb = atoi(val);
+        }
+        g_strfreev(pair);
+    }
+    g_strfreev(parts);
+
+    /* predata given only by size: one shared object per command (e.g. its reference database) */
+    if (work->num_predata == 0 && stats->size_predata > 0) {
+        memset(&work->Predata[0], 0, sizeof(DataObj));
+        snprintf(work->Predata[0].name, MAX_NAME_LENGTH_WKLD, "%s_predata", work->cmd);
+        work->Predata[0].size = stats->size_predata;
+        work->num_predata = 1;
+    } else if (work->num_predata > 0 && stats->size_predata == 0) {
+        for (i = 0; i < work->num_predata; i++) {
+            stats->size_predata += work->Predata[i].size;
         }
     }
 
@@ -177,11 +402,15 @@ Workunit* parse_workunit_by_trace(gchar* line) {
     }
 
     //filtering out jobs with 0-sized input/output size
-    if (work->stats.size_outfile == 0 || work->stats.size_infile==0 ) {
-        gchar ** parts = g_strsplit(work->id, "_", 3);
-        char* job_id = parts[0];
-        g_hash_table_remove(job_map, job_id);
-        //printf("input size of work %s is 0, delete job %s\n", work->id, job_id);
+    if (stats->size_outfile == 0 || stats->size_infile==0 ) {
+        g_hash_table_remove(job_map, work->jobid);
+        if (!dropped_jobs) {
+            dropped_jobs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        }
+        gchar *jobid = g_strdup(work->jobid);
+        g_hash_table_insert(dropped_jobs, jobid, jobid);
+        num_dropped_works += 1;
+        //printf("input size of work %s is 0, delete job %s\n", work->id, work->jobid);
         return NULL;
     }
 
@@ -189,6 +418,27 @@ Workunit* parse_workunit_by_trace(gchar* line) {
     return work;
 }
 
+/* parse task dependencies "child:parent+parent,child:parent" into job->task_dep */
+static void parse_deps(Job* jb, char* val) {
+    gchar **deps = g_strsplit(val, ",", MAX_NUM_TASKS);
+    for (int i = 0; deps[i]; i++) {
+        gchar **dep = g_strsplit(deps[i], ":", 2);
+        int child = atoi(dep[0]);
+        if (dep[1] && child >= 0 && child < MAX_NUM_TASKS) {
+            gchar **parents = g_strsplit(dep[1], "+", MAX_NUM_TASKS);
+            for (int j = 0; parents[j]; j++) {
+                int parent = atoi(parents[j]);
+                if (parent >= 0 && parent < MAX_NUM_TASKS) {
+                    jb->task_dep[child][parent] = 1;
+                }
+            }
+            g_strfreev(parents);
+        }
+        g_strfreev(dep);
+    }
+    g_strfreev(deps);
+}
+
 GHashTable* parse_jobtrace(char* jobtrace_path) {
     FILE *f;
     char line[MAX_LEN_TRACE_LINE];
@@ -199,29 +449,39 @@ GHashTable* parse_jobtrace(char* jobtrace_path) {
     }
     
     GHashTable *job_map = NULL;
-    job_map =  g_hash_table_new_full(g_str_hash, g_str_equal, free_key, free_value);
+    job_map =  g_hash_table_new(g_str_hash, g_str_equal);
     printf("[awe_server]parsing job trace ...\n");
     
     while ( fgets ( line, sizeof(line), f ) != NULL ){ /* read a line */
         Job* jb=NULL;   
         jb = parse_job_by_trace((gchar*)line);
         memset(line, 0, sizeof(line));
+        if (!job_selected(jb)) {
+            num_skipped_jobs += 1;
+            continue;
+        }
+        jb = trace_arena_copy(jb, sizeof(Job));
+        work_table_add_job(jb);
         g_hash_table_insert(job_map, jb->id, jb);
     }
+    fclose(f);
     
     printf("[awe_server]parsing job trace ... done: %u jobs parsed\n", g_hash_table_size(job_map));
+    if (num_skipped_jobs > 0) {
+        printf("[awe_server]%d jobs outside the window or sample skipped\n", num_skipped_jobs);
+    }
 
     return job_map;
 }
 
 Job* parse_job_by_trace(gchar* line) {
-    Job* jb=NULL;
-    jb = malloc(sizeof(Job));
+    Job* jb = &scratch_job;
     memset(jb, 0, sizeof(Job));
     gchar ** parts = NULL;
     g_strstrip(line);
     parts = g_strsplit(line, ";", 30);
     int i;
+    int has_deps = 0;
     for (i = 0; i < 30; i++) {
         if (!parts[i])
             break;
@@ -237,16 +497,36 @@ Job* parse_job_by_trace(gchar* line) {
             jb->num_tasks = atoi(val);
         } else if (strcmp(key, "inputsize")==0) {
         	jb->inputsize = strtoll(val, &endptr, 10);
+        } else if (strcmp(key, "user")==0 || strcmp(key, "username")==0) {
+            strncpy(jb->username, val, MAX_NAME_LENGTH_WKLD - 1);
+        } else if (strcmp(key, "project")==0) {
+            strncpy(jb->project, val, MAX_NAME_LENGTH_WKLD - 1);
+        } else if (strcmp(key, "priority")==0) {
+            jb->priority = atoi(val);
+        } else if (strcmp(key, "deps")==0) {
+            parse_deps(jb, val);
+            has_deps = 1;
         }
+        g_strfreev(pair);
     }
+    g_strfreev(parts);
     if (jb->num_tasks==0) {
         jb->num_tasks=10;
     }
+    if (jb->num_tasks > MAX_NUM_TASKS) {
+        jb->num_tasks = MAX_NUM_TASKS;
+    }
     jb->remain_tasks = jb->num_tasks;
     strcpy(jb->state, "raw");
     for (int i=0; i<jb->num_tasks; i++) {
         for (int j=0; j<jb->num_tasks; j++) {
-            jb->task_dep[i][j] = task_dep_mgrast[i][j];            
+            /* no explicit deps: the MG-RAST pipeline, which covers the first 10 tasks */
+            if (!has_deps && i < 10 && j < 10) {
+                jb->task_dep[i][j] = task_dep_mgrast[i][j];
+            }
+            if (jb->task_dep[i][j]) {
+                jb->task_parents[i] |= 1 << j;
+            }
         }
     }
     return jb;
@@ -18,25 +18,37 @@
 
 #define Mega 1048576
 
+#define MAX_NUM_SITES 16
+#define CLIENT_SITE_PREFIX "AWE_CLIENT_SITE_"
+
 typedef int bool;
 #define True 1
 #define False 0
 
-#define now_sec(lp)  ns_to_s(tw_now(lp))
+/* sim time in sec, counted from kickoff_epoch_time also when restarted from a checkpoint */
+#define now_sec(lp)  (sim_offset + ns_to_s(tw_now(lp)))
 
 extern int net_id;
 
 extern double kickoff_epoch_time;
+extern double sim_offset;
 
 extern char worktrace_file_name[256];
 extern char jobtrace_file_name[256];
 extern char output_file_name[256];
 extern float fraction;
+extern int window_start;
+extern int window_end;
+extern int job_sample_rate;
+double get_client_scale();
 
 extern const char* ready_string;
 
 extern FILE *event_log;
 
+extern int sim_finished;
+void end_simulation(tw_lp *lp);
+
 tw_stime etime_to_stime(double etime);
 
 tw_stime ns_to_s(tw_stime ns);
@@ -50,6 +62,13 @@ GHashTable* parse_worktrace(char* workload_path);
 GHashTable* parse_jobtrace(char* jobtrace_path);
 void display_hash_table(GHashTable *table, char* name);
 void print_workunit(Workunit* work);
+void get_input_object_id(Workunit* work, char* obj_id);
+
+int lp_group_exists(const char* group_name);
+int get_lp_group_idx(tw_lpid lp_id);
+int get_num_sites();
+const char* get_site_name(int site);
+int get_site_id(tw_lpid lp_id);
 
 #endif	/* UTIL_H */
 
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "work_table.h"
+
+#define WORK_TABLE_INIT_SIZE 1024
+
+WorkParams work_params;
+WorkRun *work_runs = NULL;
+Workunit **work_tab = NULL;
+Job **job_tab = NULL;
+int num_works = 0;
+int num_jobs = 0;
+
+static int work_capacity = 0;
+static int job_capacity = 0;
+
+#define GROW_COL(col, n) ((col) = realloc((col), sizeof(*(col)) * (n)))
+
+static void grow_work_table(int n) {
+    GROW_COL(work_tab, n);
+    GROW_COL(work_runs, n);
+    GROW_COL(work_params.runtime, n);
+    GROW_COL(work_params.time_data_in, n);
+    GROW_COL(work_params.time_data_out, n);
+    GROW_COL(work_params.time_predata_in, n);
+    GROW_COL(work_params.size_infile, n);
+    GROW_COL(work_params.size_outfile, n);
+    GROW_COL(work_params.size_predata, n);
+    work_capacity = n;
+}
+
+int work_table_add_job(Job *job) {
+    if (num_jobs == job_capacity) {
+        job_capacity = job_capacity ? 2 * job_capacity : WORK_TABLE_INIT_SIZE;
+        GROW_COL(job_tab, job_capacity);
+    }
+    job->idx = num_jobs;
+    job_tab[num_jobs] = job;
+    return num_jobs++;
+}
+
+int work_table_add_work(Workunit *work, WorkStat *stats) {
+    int w = num_works;
+    if (w == work_capacity) {
+        grow_work_table(work_capacity ? 2 * work_capacity : WORK_TABLE_INIT_SIZE);
+    }
+    work->idx = w;
+    work_tab[w] = work;
+    work_params.runtime[w] = stats->runtime;
+    work_params.time_data_in[w] = stats->time_data_in;
+    work_params.time_data_out[w] = stats->time_data_out;
+    work_params.time_predata_in[w] = stats->time_predata_in;
+    work_params.size_infile[w] = stats->size_infile;
+    work_params.size_outfile[w] = stats->size_outfile;
+    work_params.size_predata[w] = stats->size_predata;
+    memset(&work_runs[w], 0, sizeof(WorkRun));
+    return num_works++;
+}
+
+/* back to the state right after parsing: no job submitted, no workunit run */
+static void reset_job(Job *job) {
+    strcpy(job->state, "raw");
+    job->remain_tasks = job->num_tasks;
+    job->stats.start = 0;
+    job->stats.end = 0;
+    for (int i = 0; i < job->num_tasks; i++) {
+        job->task_remainwork[i] = job->task_splits[i];
+        job->task_states[i] = 0;
+        memset(&job->task_stats[i], 0, sizeof(TaskStat));
+        for (int j = 0; j < job->num_tasks; j++) {
+            job->task_dep[i][j] = (job->task_parents[i] >> j) & 1;
+        }
+    }
+}
+
+void work_table_reset() {
+    memset(work_runs, 0, sizeof(WorkRun) * num_works);
+    for (int i = 0; i < num_jobs; i++) {
+        reset_job(job_tab[i]);
+    }
+}
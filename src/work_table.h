@@ -0,0 +1,96 @@
+/*
+ * File:   work_table.h
+ *
+ * Dense integer indices for jobs and workunits. Every accepted trace record
+ * gets the next index at parse time, events carry it in awe_msg.obj_idx, and
+ * the handlers find their record with one indexed load instead of a string
+ * hash lookup. job_map and work_map keep resolving string ids, for the trace
+ * parsers, checkpoints and logs.
+ *
+ * Per-workunit numbers are split by who writes them. work_params holds the
+ * trace inputs (sizes, times), one array per field, written at parse time
+ * only: sweep workers forked after parsing share these pages. work_runs
+ * holds what a run changes (timestamps, state), one small record per
+ * workunit, which work_table_reset() clears to replay the trace without
+ * parsing it again.
+ *
+ * Created on July 10, 2014, 9:40 AM
+ */
+
+#ifndef WORK_TABLE_H
+#define	WORK_TABLE_H
+
+#include <stdint.h>
+#include "ross.h"
+#include "glib.h"
+#include "awe_types.h"
+
+typedef struct WorkParams WorkParams;
+struct WorkParams {
+    double *runtime;
+    double *time_data_in;
+    double *time_data_out;
+    double *time_predata_in;
+    uint64_t *size_infile;
+    uint64_t *size_outfile;
+    uint64_t *size_predata;
+};
+
+/* WorkRun.state */
+#define WORK_PENDING 0
+#define WORK_QUEUED 1   /* in a server queue at restart */
+#define WORK_DONE 2
+
+typedef struct WorkRun WorkRun;
+struct WorkRun {
+    /* in sim sec */
+    double st_created;
+    double st_checkout;
+    double st_download_start;
+    double st_download_end;
+    double st_upload_start;
+    double st_upload_end;
+    int state;
+    /* copies handed to clients, see straggler.h */
+    int attempts;          /* checkouts so far, numbers the copies */
+    int attempt;           /* first copy */
+    tw_lpid client;
+    int spec;              /* 0: no duplicate, 1: duplicate queued, 2: duplicate running */
+    int promoted;          /* queued duplicate that took over from a lost first copy */
+    int spec_attempt;
+    tw_lpid spec_client;
+    /* client failures, see failure.h */
+    int client_epoch;      /* of the client of the first copy at checkout */
+    int spec_epoch;
+    double saved;          /* share of the compute kept in workunit checkpoints */
+    /* fair-share, see fairshare.h */
+    GList *queue_link;     /* in the server work_queue while queued */
+    GList *fs_link;        /* in its user queue while queued */
+    double fs_charge;      /* usage charged ahead of the actual execution time, scaled to fs_charge_ref */
+    double fs_charge_ref;
+    /* critical-path and shortest-job-first heaps, see critpath.h and predict.h */
+    int heap_pos;
+    uint64_t queue_seq;
+    double pred_runtime;   /* in sec, predicted when queued */
+};
+
+extern WorkParams work_params;
+extern WorkRun *work_runs;   /* work idx -> state of the current run */
+extern Workunit **work_tab;  /* work idx -> workunit */
+extern Job **job_tab;        /* job idx -> job */
+extern int num_works;
+extern int num_jobs;
+
+int work_table_add_job(Job *job);
+int work_table_add_work(Workunit *work, WorkStat *stats);
+void work_table_reset();
+
+static inline Workunit* get_work(int idx) {
+    return work_tab[idx];
+}
+
+static inline Job* get_job(int idx) {
+    return job_tab[idx];
+}
+
+#endif	/* WORK_TABLE_H */